@@ -0,0 +1,76 @@
+/*
+compile with: gcc -c adaptive.c
+*/
+
+#include <math.h>
+#include "tracker.h"
+#include "adaptive.h"
+
+void adaptive_init(adaptive_t *a, const observer_t *obs, adaptive_ha_fn ha_at, void *ctx){
+    a->mode = ADAPTIVE_TRACKING;
+    a->obs = obs;
+    a->ha_at = ha_at;
+    a->ctx = ctx;
+    a->setpoint = 0;
+    a->error = 0;
+    a->refresh_at = NAN;
+    a->sunrise = NAN;
+    a->sunset = NAN;
+    a->parked = -1; // unknown, forces a refresh
+    a->updates = 0;
+    a->ephemeris_calls = 0;
+}
+
+// seconds until ha_to_setpoint() can change, from the hour angle now and baseline seconds later
+static double until_next_tick(double ha, double ha_later, double baseline){
+    double rate = remainder(ha_later - ha, 2*PI) / (2*PI) * TICKS_PER_REV / baseline; // ticks/s
+    if (fabs(rate) < 1e-9) return INFINITY;
+    double ticks = ha_to_ticks(ha);
+    double distance = rate > 0 ? floor(ticks) + 1.0 - ticks : ticks - (ceil(ticks) - 1.0);
+    return distance / fabs(rate);
+}
+
+static void refresh(adaptive_t *a, double now, int park){
+    double unpark = a->sunrise - ADAPTIVE_UNPARK_LEAD_S;
+    if (park){
+        // wait facing where the sun comes up
+        double at = isnan(a->sunrise) ? now : a->sunrise;
+        a->setpoint = ha_to_setpoint(a->ha_at(at, a->ctx));
+        a->ephemeris_calls++;
+        a->refresh_at = isnan(a->sunrise) ? now + ADAPTIVE_MAX_SLEEP_S : fmin(unpark + ADAPTIVE_CROSSING_MARGIN_S, now + ADAPTIVE_MAX_SLEEP_S);
+    } else {
+        double ha = a->ha_at(now, a->ctx);
+        double ha_later = a->ha_at(now + ADAPTIVE_RATE_BASELINE_S, a->ctx);
+        a->ephemeris_calls += 2;
+        a->setpoint = ha_to_setpoint(ha);
+        double next = now + until_next_tick(ha, ha_later, ADAPTIVE_RATE_BASELINE_S) + ADAPTIVE_CROSSING_MARGIN_S;
+        next = fmin(next, now + ADAPTIVE_MAX_SLEEP_S);
+        if (!isnan(a->sunset)) next = fmin(next, a->sunset + ADAPTIVE_CROSSING_MARGIN_S); // park right after sunset
+        a->refresh_at = next;
+    }
+    a->parked = park;
+}
+
+double adaptive_update(adaptive_t *a, double now, long encoder_ticks){
+    a->updates++;
+
+    // NAN never compares, so polar day/night is looked at again on every update
+    if (!(now < a->sunrise)) a->sunrise = solar_next_crossing(now, a->obs, SOLAR_HORIZON, 1);
+    if (!(now < a->sunset)) a->sunset = solar_next_crossing(now, a->obs, SOLAR_HORIZON, 0);
+    int night = isnan(a->sunset) ? 0 : isnan(a->sunrise) ? 1 : a->sunrise < a->sunset;
+    int park = night && !(now >= a->sunrise - ADAPTIVE_UNPARK_LEAD_S);
+
+    if (park != a->parked || !(now < a->refresh_at)) refresh(a, now, park);
+
+    a->error = wrap_error((float)(a->setpoint - encoder_ticks));
+    float abs_error = fabsf(a->error);
+    if (abs_error > ADAPTIVE_SLEW_TICKS){
+        a->mode = ADAPTIVE_SLEWING;
+    } else if (a->mode != ADAPTIVE_SLEWING || abs_error < ADAPTIVE_SETTLED_TICKS){
+        a->mode = park ? ADAPTIVE_PARKED : ADAPTIVE_TRACKING;
+    }
+
+    if (a->mode == ADAPTIVE_SLEWING) return now + PID_PERIOD / 1000.0;
+    if (abs_error >= 1.0f) return fmin(a->refresh_at, now + ADAPTIVE_MOVING_S); // correction under way
+    return a->refresh_at;
+}
@@ -0,0 +1,60 @@
+/*
+Event driven control rate. At sidereal speed the setpoint moves one tick every ~17 s, so
+instead of running the loop at 1 kHz around the clock the guidance thread sleeps until the
+sun crosses the next tick boundary or an encoder edge arrives. The fixed 1 kHz loop only runs
+while the error is large(slews, gusts), and between sunset and sunrise the axis waits at the
+sunrise position. Pure logic like tracker.c, main.c and tracking_sim.c drive it.
+*/
+
+#ifndef TRACKING_ADAPTIVE_H
+#define TRACKING_ADAPTIVE_H
+
+#include <stdint.h>
+#include "solar.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADAPTIVE_SLEW_TICKS 3.0f      // error that switches to the fixed rate loop
+#define ADAPTIVE_SETTLED_TICKS 1.0f   // back to event driven once the error is below this
+#define ADAPTIVE_MOVING_S 0.05        // wake period while a small correction is being stepped
+#define ADAPTIVE_MAX_SLEEP_S 600.0    // wake at least this often, in case an event got lost
+#define ADAPTIVE_UNPARK_LEAD_S 600.0  // leave the park position this long before sunrise
+#define ADAPTIVE_RATE_BASELINE_S 60.0 // hour angle rate from two ephemeris samples this far apart
+#define ADAPTIVE_CROSSING_MARGIN_S 0.001
+
+typedef enum {
+    ADAPTIVE_TRACKING, // following the sun, woken by tick crossings and encoder edges
+    ADAPTIVE_SLEWING,  // large error, loop runs every PID_PERIOD
+    ADAPTIVE_PARKED    // sun is down, holding the sunrise position
+} adaptive_mode_t;
+
+// sun hour angle [rad] at a unix time, so main.c can use SPICE or the ephemeris service
+typedef double (*adaptive_ha_fn)(double unix_time, void *ctx);
+
+typedef struct {
+    adaptive_mode_t mode;
+    const observer_t *obs;
+    adaptive_ha_fn ha_at;
+    void *ctx;
+    long setpoint;
+    float error;       // setpoint - encoder at the last update [ticks]
+    double refresh_at; // setpoint stays valid until then [unix s]
+    double sunrise;    // next sunrise [unix s], NAN if none within two days
+    double sunset;
+    int parked;
+    long updates;
+    long ephemeris_calls;
+} adaptive_t;
+
+void adaptive_init(adaptive_t *a, const observer_t *obs, adaptive_ha_fn ha_at, void *ctx);
+// Picks the setpoint and returns when the loop has to run next [unix s]. The caller feeds
+// a->error to the PID, and also runs the loop early when an encoder edge comes in.
+double adaptive_update(adaptive_t *a, double now, long encoder_ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,114 @@
+/*
+compile with: gcc -c clock.c
+*/
+
+#include <time.h>
+#include <errno.h>
+#include "clock.h"
+
+static clock_mode_t mode = CLOCK_MODE_REAL;
+static double scale = 1.0;
+static uint64_t epoch_ns = 0;     // clock time at the moment the clock was started
+static uint64_t mono_start_ns = 0; // CLOCK_MONOTONIC at the moment the clock was started
+static uint64_t sim_now_ns = 0;
+
+static uint64_t read_ns(clockid_t id){
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static void real_sleep_ns(uint64_t ns){
+    struct timespec ts;
+    ts.tv_sec = ns / NS_PER_SEC;
+    ts.tv_nsec = ns % NS_PER_SEC;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR){
+        continue;
+    }
+}
+
+void clock_init_real(void){
+    mode = CLOCK_MODE_REAL;
+    scale = 1.0;
+}
+
+void clock_init_scaled(double s, time_t start_utc){
+    mode = CLOCK_MODE_SCALED;
+    scale = (s > 0.0) ? s : 1.0;
+    epoch_ns = start_utc ? (uint64_t)start_utc * NS_PER_SEC : read_ns(CLOCK_REALTIME);
+    mono_start_ns = read_ns(CLOCK_MONOTONIC);
+}
+
+void clock_init_simulated(time_t start_utc){
+    mode = CLOCK_MODE_SIMULATED;
+    scale = 1.0;
+    sim_now_ns = start_utc ? (uint64_t)start_utc * NS_PER_SEC : read_ns(CLOCK_REALTIME);
+}
+
+clock_mode_t clock_mode(void){
+    return mode;
+}
+
+uint64_t clock_now_ns(void){
+    switch (mode){
+    case CLOCK_MODE_SCALED:
+        return epoch_ns + (uint64_t)((double)(read_ns(CLOCK_MONOTONIC) - mono_start_ns) * scale);
+    case CLOCK_MODE_SIMULATED:
+        return sim_now_ns;
+    default:
+        return read_ns(CLOCK_REALTIME);
+    }
+}
+
+time_t clock_time(void){
+    return (time_t)(clock_now_ns() / NS_PER_SEC);
+}
+
+void clock_sleep_ns(uint64_t ns){
+    switch (mode){
+    case CLOCK_MODE_SCALED:
+        real_sleep_ns((uint64_t)((double)ns / scale));
+        break;
+    case CLOCK_MODE_SIMULATED:
+        sim_now_ns += ns;
+        break;
+    default:
+        real_sleep_ns(ns);
+        break;
+    }
+}
+
+void clock_sleep_us(uint32_t us){
+    clock_sleep_ns((uint64_t)us * NS_PER_US);
+}
+
+void clock_sleep_until_ns(uint64_t deadline_ns){
+    uint64_t now = clock_now_ns();
+    if (deadline_ns > now) clock_sleep_ns(deadline_ns - now);
+}
+
+int clock_cond_wait_until_ns(pthread_cond_t *cond, pthread_mutex_t *mutex, uint64_t deadline_ns){
+    uint64_t now = clock_now_ns();
+    if (mode == CLOCK_MODE_SIMULATED){
+        if (deadline_ns > now) sim_now_ns = deadline_ns;
+        return ETIMEDOUT;
+    }
+    if (deadline_ns <= now) return ETIMEDOUT;
+
+    // the condition variable waits on CLOCK_REALTIME, convert the remaining time to real time
+    uint64_t remaining = deadline_ns - now;
+    if (mode == CLOCK_MODE_SCALED) remaining = (uint64_t)((double)remaining / scale);
+    uint64_t real_deadline = read_ns(CLOCK_REALTIME) + remaining;
+    struct timespec ts;
+    ts.tv_sec = real_deadline / NS_PER_SEC;
+    ts.tv_nsec = real_deadline % NS_PER_SEC;
+    return pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+void clock_advance_ns(uint64_t ns){
+    if (mode == CLOCK_MODE_SIMULATED) sim_now_ns += ns;
+}
+
+void clock_set_ns(uint64_t now_ns){
+    if (mode == CLOCK_MODE_SIMULATED) sim_now_ns = now_ns;
+}
@@ -0,0 +1,54 @@
+/*
+Pluggable time source for the tracker. Everything that needs "now" or has to wait
+goes through here instead of time(NULL)/nanosleep/usleep, so the same control code
+can run against the wall clock, a sped up clock, or a fully simulated one.
+*/
+
+#ifndef TRACKING_CLOCK_H
+#define TRACKING_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NS_PER_SEC 1000000000ULL
+#define NS_PER_US  1000ULL
+
+typedef enum {
+    CLOCK_MODE_REAL,      // wall clock, sleeps really sleep
+    CLOCK_MODE_SCALED,    // wall clock sped up by a factor, sleeps are shortened
+    CLOCK_MODE_SIMULATED  // time only moves when someone sleeps or calls clock_advance_ns
+} clock_mode_t;
+
+// default after startup is CLOCK_MODE_REAL, so the tracker works without calling any init
+void clock_init_real(void);
+// start_utc is the simulated UTC at the moment of the call, 0 means "now"
+void clock_init_scaled(double scale, time_t start_utc);
+// single threaded only: every sleep just moves virtual time forward, nothing blocks
+void clock_init_simulated(time_t start_utc);
+
+clock_mode_t clock_mode(void);
+
+uint64_t clock_now_ns(void); // ns since unix epoch, in the clock's timeline
+time_t clock_time(void);     // drop-in for time(NULL)
+
+void clock_sleep_ns(uint64_t ns);
+void clock_sleep_us(uint32_t us);
+void clock_sleep_until_ns(uint64_t deadline_ns);
+// pthread_cond_timedwait with a deadline in the clock's timeline, mutex has to be locked.
+// Returns 0 when signalled, ETIMEDOUT at the deadline. Simulated clock: jumps to the deadline.
+int clock_cond_wait_until_ns(pthread_cond_t *cond, pthread_mutex_t *mutex, uint64_t deadline_ns);
+
+// only meaningful in CLOCK_MODE_SIMULATED, ignored otherwise
+void clock_advance_ns(uint64_t ns);
+void clock_set_ns(uint64_t now_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+/*
+Ephemeris service throughput and round trip latency for 1..16 clients, against every tracker
+calling getHa() itself. The service runs in a thread of this process, the shared memory and
+futex path is the same one ephemd.exe and the trackers use.
+compile with: gcc -O2 -fopenmp-simd -DLATENCY_PROBES -o ephem_bench.exe ephem_bench.c ephem_service.c ephemeris.c clock.c solar.c latency.c -I/path/to/cspice/include -L/path/to/cspice/lib -lm -lcspice -lpthread -lrt
+or without CSPICE: gcc -O2 -fopenmp-simd -DLATENCY_PROBES -DEPHEMERIS_ANALYTIC -o ephem_bench.exe ephem_bench.c ephem_service.c ephemeris.c clock.c solar.c latency.c -lm -lpthread -lrt
+usage: ./ephem_bench.exe [queries per client]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "ephem_service.h"
+#include "latency.h"
+
+#ifndef LATENCY_PROBES
+
+int main(void){
+    printf("build with -DLATENCY_PROBES, the round trip times come from the LAT_EPHEM_QUERY probe\n");
+    return 0;
+}
+
+#else
+
+#define START_UNIX 1735689600.0 // 2025-01-01
+#define YEAR_S (365.0 * 86400.0)
+
+typedef enum {
+    WORKLOAD_SHARED,   // every client tracks the sun at 1 kHz on the same clock, answers can be shared
+    WORKLOAD_DISTINCT, // random times over a year, nothing to share, batching only
+} workload_t;
+
+typedef struct {
+    ephem_shm_t *shm;
+    workload_t workload;
+    int queries;
+    unsigned seed;
+} client_arg_t;
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *service_thread(void *arg){
+    ephem_service_run(arg);
+    return NULL;
+}
+
+static void *client_thread(void *arg){
+    client_arg_t *c = arg;
+    ephem_client_t client;
+    volatile double sink = 0;
+    if (ephem_client_attach(&client, c->shm, NULL) != 0){
+        printf("no free client slot\n");
+        return NULL;
+    }
+    for (int i = 0; i < c->queries; i++){
+        double t = c->workload == WORKLOAD_SHARED
+            ? START_UNIX + i * 0.001
+            : START_UNIX + (double)rand_r(&c->seed) / RAND_MAX * YEAR_S;
+        sink += ephem_client_ha(&client, EPHEM_SUN, 0, t);
+    }
+    ephem_client_detach(&client);
+    return NULL;
+}
+
+static void direct(int queries){
+    volatile double sink = 0;
+    unsigned seed = 1;
+    double start = now_s();
+    for (int i = 0; i < queries; i++){
+        double t = START_UNIX + (double)rand_r(&seed) / RAND_MAX * YEAR_S;
+        sink += getHaAt(ephemerisTimeFromUnix(t));
+    }
+    double elapsed = now_s() - start;
+    printf("direct getHaAt()   %10.0f queries/s   %8.3f us each\n\n", queries / elapsed, elapsed / queries * 1e6);
+}
+
+static void run(ephem_shm_t *shm, workload_t workload, int clients, int queries){
+    pthread_t threads[EPHEM_MAX_CLIENTS];
+    client_arg_t args[EPHEM_MAX_CLIENTS];
+    ephem_stats_t before, after;
+
+    latency_reset();
+    ephem_service_stats(shm, &before);
+    double start = now_s();
+    for (int i = 0; i < clients; i++){
+        args[i] = (client_arg_t){shm, workload, queries, (unsigned)(i + 1)};
+        pthread_create(&threads[i], NULL, client_thread, &args[i]);
+    }
+    for (int i = 0; i < clients; i++) pthread_join(threads[i], NULL);
+    double elapsed = now_s() - start;
+    ephem_service_stats(shm, &after);
+
+    uint64_t requests = after.requests - before.requests;
+    uint64_t batches = after.batches - before.batches;
+    uint64_t computed = after.computed - before.computed;
+    printf("%-9s %3d %12.0f %9.2f %9.1f%% %9.2f %9.2f %9.2f\n",
+        workload == WORKLOAD_SHARED ? "shared" : "distinct", clients,
+        requests / elapsed,
+        batches ? (double)requests / batches : 0.0,
+        requests ? 100.0 * computed / requests : 0.0,
+        latency_percentile(LAT_EPHEM_QUERY, 0.50) / 1e3,
+        latency_percentile(LAT_EPHEM_QUERY, 0.99) / 1e3,
+        latency_percentile(LAT_EPHEM_QUERY, 0.999) / 1e3);
+}
+
+int main(int argc, char **argv){
+    int queries = 20000;
+    if (argc > 1) queries = atoi(argv[1]);
+
+    latency_init();
+    ephemeris_init();
+    direct(queries);
+
+    ephem_shm_t *shm = ephem_service_create(NULL, EPHEM_BUCKET_S);
+    pthread_t service;
+    pthread_create(&service, NULL, service_thread, shm);
+
+    printf("%-9s %3s %12s %9s %10s %9s %9s %9s\n", "workload", "n", "queries/s", "batch", "computed", "p50[us]", "p99[us]", "p99.9[us]");
+    for (int w = WORKLOAD_SHARED; w <= WORKLOAD_DISTINCT; w++){
+        for (int clients = 1; clients <= EPHEM_MAX_CLIENTS; clients *= 2){
+            run(shm, (workload_t)w, clients, queries);
+        }
+    }
+
+    ephem_service_stop(shm);
+    pthread_join(service, NULL);
+    ephem_service_destroy(shm, NULL);
+    ephemeris_close();
+    return 0;
+}
+
+#endif
@@ -0,0 +1,459 @@
+/*
+compile with: gcc -O2 -c ephem_service.c -I/path/to/cspice/include
+or without CSPICE: gcc -O2 -DEPHEMERIS_ANALYTIC -c ephem_service.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "ephemeris.h"
+#include "ephem_service.h"
+#include "latency.h"
+
+#define EPHEM_MAGIC 0x45504832u
+#define QUEUE_MASK (EPHEM_QUEUE_LEN - 1)
+#define MAX_PENDING (EPHEM_MAX_CLIENTS * EPHEM_QUEUE_LEN)
+#define HASH_SIZE (2 * MAX_PENDING) // power of two
+#define CACHE_SIZE 256              // recently computed results, power of two
+#define CLIENT_SPINS 200            // polls before a client sleeps on the futex
+
+#ifndef EPHEMERIS_ANALYTIC
+static const char *TARGET_NAMES[EPHEM_TARGETS] = {"SUN", "MOON"};
+#endif
+
+typedef struct {
+    double unix_time;
+    uint32_t id;
+    uint8_t target;
+    uint8_t observer;
+} ephem_request_t;
+
+typedef struct {
+    uint32_t id;
+    int32_t status; // 0, or the errno value the client reports
+    double ha;
+} ephem_response_t;
+
+typedef struct {
+    _Atomic uint32_t in_use;
+    _Atomic int32_t owner;      // pid of the client, the slot is taken over once it is gone
+    _Atomic uint32_t client_waiting;
+    _Atomic uint32_t req_head;  // written by the client
+    _Atomic uint32_t req_tail;  // written by the service
+    _Atomic uint32_t resp_head; // written by the service, the client sleeps on it
+    _Atomic uint32_t resp_tail; // written by the client
+    ephem_request_t req[EPHEM_QUEUE_LEN];
+    ephem_response_t resp[EPHEM_QUEUE_LEN];
+} __attribute__((aligned(64))) ephem_slot_t;
+
+struct ephem_shm {
+    uint32_t magic;
+    int32_t service_pid;
+    double bucket_s;
+    _Atomic uint32_t running;
+    _Atomic uint32_t work;            // bumped by clients after queueing, the service sleeps on it
+    _Atomic uint32_t service_waiting;
+    _Atomic uint32_t n_observers;
+    observer_t observers[EPHEM_MAX_OBSERVERS];
+    _Atomic uint64_t requests;
+    _Atomic uint64_t computed;
+    _Atomic uint64_t batches;
+    ephem_slot_t slots[EPHEM_MAX_CLIENTS];
+};
+
+// one distinct (target, observer, bucket) of the current pass
+typedef struct {
+    uint64_t key;
+    double first, last; // earliest and latest requested time
+    double unix_time;   // time the answer is computed for, halfway between first and last
+    double ha;
+    uint8_t target;
+    uint8_t observer;
+} ephem_unique_t;
+
+typedef struct {
+    int slot;
+    uint32_t id;
+    int unique; // -1 for a rejected request
+} ephem_pending_t;
+
+// service thread only
+static ephem_pending_t pending[MAX_PENDING];
+static ephem_unique_t unique[MAX_PENDING];
+static int hash_table[HASH_SIZE];
+static struct {
+    uint64_t key;
+    double unix_time;
+    double ha;
+    int valid;
+} cache[CACHE_SIZE];
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int process_alive(int32_t pid){
+    return pid <= 0 || kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+static long futex_wait(_Atomic uint32_t *addr, uint32_t val){
+    return syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+static long futex_wake(_Atomic uint32_t *addr){
+    return syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// waits while *addr == val, at most until deadline_ns(CLOCK_MONOTONIC). 0 when woken or changed.
+static int futex_wait_until(_Atomic uint32_t *addr, uint32_t val, uint64_t deadline_ns){
+    uint64_t now = now_ns();
+    if (now >= deadline_ns) return -1;
+    struct timespec ts = {(time_t)((deadline_ns - now) / 1000000000ULL), (long)((deadline_ns - now) % 1000000000ULL)};
+    if (syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0) != 0 && errno == ETIMEDOUT) return -1;
+    return 0;
+}
+
+static uint64_t mix(uint64_t x){
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// a key that is equal for every query that may share an answer
+static uint64_t request_key(const ephem_shm_t *shm, const ephem_request_t *r){
+    uint64_t bits;
+    double bucket = shm->bucket_s > 0 ? floor(r->unix_time / shm->bucket_s) : r->unix_time;
+    memcpy(&bits, &bucket, sizeof(bits));
+    return mix(bits ^ ((uint64_t)r->target << 56) ^ ((uint64_t)r->observer << 48));
+}
+
+ephem_shm_t *ephem_service_create(const char *name, double bucket_s){
+    ephem_shm_t *shm;
+    if (name){
+        shm_unlink(name);
+        int fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+        if (fd < 0) return NULL;
+        if (ftruncate(fd, sizeof(ephem_shm_t)) != 0){
+            close(fd);
+            return NULL;
+        }
+        shm = mmap(NULL, sizeof(ephem_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    } else {
+        // in-process service, threads only
+        shm = mmap(NULL, sizeof(ephem_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    }
+    if (shm == MAP_FAILED) return NULL;
+
+    memset(shm, 0, sizeof(*shm));
+    shm->service_pid = getpid();
+    shm->bucket_s = bucket_s;
+    shm->observers[0] = SOLAR_SITE;
+    atomic_store(&shm->n_observers, 1);
+    atomic_store(&shm->running, 1);
+    shm->magic = EPHEM_MAGIC;
+    return shm;
+}
+
+int ephem_service_add_observer(ephem_shm_t *shm, const observer_t *obs){
+    uint32_t n = atomic_load(&shm->n_observers);
+    if (n >= EPHEM_MAX_OBSERVERS) return -1;
+    shm->observers[n] = *obs;
+    atomic_store(&shm->n_observers, n + 1);
+    return (int)n;
+}
+
+void ephem_service_stop(ephem_shm_t *shm){
+    atomic_store(&shm->running, 0);
+    atomic_fetch_add(&shm->work, 1);
+    futex_wake(&shm->work);
+}
+
+void ephem_service_destroy(ephem_shm_t *shm, const char *name){
+    munmap(shm, sizeof(*shm));
+    if (name) shm_unlink(name);
+}
+
+void ephem_service_stats(ephem_shm_t *shm, ephem_stats_t *stats){
+    stats->requests = atomic_load_explicit(&shm->requests, memory_order_relaxed);
+    stats->computed = atomic_load_explicit(&shm->computed, memory_order_relaxed);
+    stats->batches = atomic_load_explicit(&shm->batches, memory_order_relaxed);
+}
+
+// targets and observers this build can answer for
+static int request_valid(ephem_shm_t *shm, const ephem_request_t *r){
+#ifdef EPHEMERIS_ANALYTIC
+    if (r->target != EPHEM_SUN) return 0;
+#else
+    if (r->target >= EPHEM_TARGETS) return 0;
+#endif
+    return r->observer < atomic_load(&shm->n_observers);
+}
+
+// takes everything that is queued, coalescing identical queries. Returns the number of requests.
+static int collect(ephem_shm_t *shm, int *n_unique){
+    int n = 0;
+    *n_unique = 0;
+    memset(hash_table, -1, sizeof(hash_table));
+
+    for (int s = 0; s < EPHEM_MAX_CLIENTS; s++){
+        ephem_slot_t *slot = &shm->slots[s];
+        if (!atomic_load_explicit(&slot->in_use, memory_order_acquire)) continue;
+
+        uint32_t head = atomic_load_explicit(&slot->req_head, memory_order_acquire);
+        uint32_t tail = atomic_load_explicit(&slot->req_tail, memory_order_relaxed);
+        for (; tail != head; tail++){
+            const ephem_request_t *r = &slot->req[tail & QUEUE_MASK];
+            pending[n].slot = s;
+            pending[n].id = r->id;
+            if (!request_valid(shm, r)){
+                pending[n++].unique = -1;
+                continue;
+            }
+            uint64_t key = request_key(shm, r);
+
+            int h = (int)(key & (HASH_SIZE - 1));
+            while (hash_table[h] >= 0 && unique[hash_table[h]].key != key) h = (h + 1) & (HASH_SIZE - 1);
+            if (hash_table[h] < 0){
+                ephem_unique_t *u = &unique[*n_unique];
+                u->key = key;
+                u->first = u->last = r->unix_time;
+                u->target = r->target;
+                u->observer = r->observer;
+                u->ha = NAN;
+                hash_table[h] = (*n_unique)++;
+            } else {
+                ephem_unique_t *u = &unique[hash_table[h]];
+                if (r->unix_time < u->first) u->first = r->unix_time;
+                if (r->unix_time > u->last) u->last = r->unix_time;
+            }
+            pending[n++].unique = hash_table[h];
+        }
+        atomic_store_explicit(&slot->req_tail, tail, memory_order_release);
+    }
+    return n;
+}
+
+static void compute(ephem_shm_t *shm, int n_unique){
+    int todo[MAX_PENDING];
+    int n_todo = 0;
+
+    // a single requester gets its exact time, a cached answer only if it is as close as that
+    for (int i = 0; i < n_unique; i++){
+        ephem_unique_t *u = &unique[i];
+        u->unix_time = 0.5 * (u->first + u->last);
+        int c = (int)(u->key & (CACHE_SIZE - 1));
+        double reach = 0.5 * shm->bucket_s;
+        if (cache[c].valid && cache[c].key == u->key
+            && fabs(cache[c].unix_time - u->first) <= reach && fabs(cache[c].unix_time - u->last) <= reach){
+            u->ha = cache[c].ha;
+        } else {
+            todo[n_todo++] = i;
+        }
+    }
+
+#ifdef EPHEMERIS_ANALYTIC
+    // sun queries go through the batch engine, one call per observer
+    static double times[MAX_PENDING], has[MAX_PENDING];
+    int index[MAX_PENDING];
+    for (uint32_t o = 0; o < atomic_load(&shm->n_observers); o++){
+        int m = 0;
+        for (int i = 0; i < n_todo; i++){
+            ephem_unique_t *u = &unique[todo[i]];
+            if (u->observer != o || u->target != EPHEM_SUN) continue;
+            times[m] = u->unix_time;
+            index[m++] = todo[i];
+        }
+        if (m == 0) continue;
+        solar_position_batch(times, m, &shm->observers[o], NULL, NULL, has, NULL, NULL);
+        for (int i = 0; i < m; i++) unique[index[i]].ha = has[i];
+    }
+#else
+    for (int i = 0; i < n_todo; i++){
+        ephem_unique_t *u = &unique[todo[i]];
+        u->ha = getHaFor(TARGET_NAMES[u->target], &shm->observers[u->observer], ephemerisTimeFromUnix(u->unix_time));
+    }
+#endif
+
+    for (int i = 0; i < n_todo; i++){
+        ephem_unique_t *u = &unique[todo[i]];
+        int c = (int)(u->key & (CACHE_SIZE - 1));
+        cache[c].key = u->key;
+        cache[c].unix_time = u->unix_time;
+        cache[c].ha = u->ha;
+        cache[c].valid = 1;
+    }
+    atomic_fetch_add_explicit(&shm->computed, n_todo, memory_order_relaxed);
+}
+
+static void respond(ephem_shm_t *shm, int n){
+    uint32_t woken = 0; // bit per slot that got an answer
+    for (int i = 0; i < n; i++){
+        ephem_slot_t *slot = &shm->slots[pending[i].slot];
+        uint32_t head = atomic_load_explicit(&slot->resp_head, memory_order_relaxed);
+        if (head - atomic_load_explicit(&slot->resp_tail, memory_order_acquire) >= EPHEM_QUEUE_LEN){
+            continue; // ring full of answers to queries the client gave up on, or the client is gone
+        }
+        ephem_response_t *resp = &slot->resp[head & QUEUE_MASK];
+        resp->id = pending[i].id;
+        resp->status = pending[i].unique < 0 ? EINVAL : 0;
+        resp->ha = pending[i].unique < 0 ? NAN : unique[pending[i].unique].ha;
+        atomic_store(&slot->resp_head, head + 1);
+        woken |= 1u << pending[i].slot;
+    }
+    for (int s = 0; s < EPHEM_MAX_CLIENTS; s++){
+        if ((woken & (1u << s)) && atomic_load(&shm->slots[s].client_waiting)){
+            futex_wake(&shm->slots[s].resp_head);
+        }
+    }
+    atomic_fetch_add_explicit(&shm->requests, n, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shm->batches, 1, memory_order_relaxed);
+}
+
+void ephem_service_run(ephem_shm_t *shm){
+    memset(cache, 0, sizeof(cache));
+    while (atomic_load(&shm->running)){
+        uint32_t work = atomic_load(&shm->work);
+        int n_unique;
+        int n = collect(shm, &n_unique);
+        if (n == 0){
+            // announce the nap, then look once more so a request queued meanwhile is not missed
+            atomic_store(&shm->service_waiting, 1);
+            if (atomic_load(&shm->work) == work) futex_wait(&shm->work, work);
+            atomic_store(&shm->service_waiting, 0);
+            continue;
+        }
+        compute(shm, n_unique);
+        respond(shm, n);
+    }
+}
+
+static int take_slot(ephem_client_t *client, ephem_shm_t *shm, int s){
+    ephem_slot_t *slot = &shm->slots[s];
+    // leftovers of an earlier client: let the service drain them, drop stale answers
+    uint64_t deadline = now_ns() + EPHEM_TIMEOUT_MS * 1000000ULL;
+    while (atomic_load(&slot->req_tail) != atomic_load(&slot->req_head)){
+        if (now_ns() >= deadline){
+            atomic_store(&slot->in_use, 0);
+            return -1;
+        }
+        sched_yield();
+    }
+    atomic_store(&slot->resp_tail, atomic_load(&slot->resp_head));
+    client->shm = shm;
+    client->slot = s;
+    client->next_id = 1;
+    return 0;
+}
+
+int ephem_client_attach(ephem_client_t *client, ephem_shm_t *shm, const char *name){
+    int mapped = 0;
+    if (shm == NULL){
+        int fd = shm_open(name, O_RDWR, 0);
+        if (fd < 0) return -1;
+        shm = mmap(NULL, sizeof(ephem_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (shm == MAP_FAILED) return -1;
+        mapped = 1;
+        if (shm->magic != EPHEM_MAGIC || !atomic_load(&shm->running) || !process_alive(shm->service_pid)){
+            munmap(shm, sizeof(ephem_shm_t));
+            return -1;
+        }
+    }
+
+    int32_t pid = getpid();
+    for (int s = 0; s < EPHEM_MAX_CLIENTS; s++){
+        ephem_slot_t *slot = &shm->slots[s];
+        uint32_t expected = 0;
+        if (!atomic_compare_exchange_strong(&slot->in_use, &expected, 1)) continue;
+        atomic_store(&slot->owner, pid);
+        if (take_slot(client, shm, s) == 0) return 0;
+    }
+    // all taken, reclaim one whose client died without detaching
+    for (int s = 0; s < EPHEM_MAX_CLIENTS; s++){
+        ephem_slot_t *slot = &shm->slots[s];
+        int32_t owner = atomic_load(&slot->owner);
+        if (process_alive(owner) || !atomic_compare_exchange_strong(&slot->owner, &owner, pid)) continue;
+        atomic_store(&slot->in_use, 1);
+        if (take_slot(client, shm, s) == 0) return 0;
+    }
+    if (mapped) munmap(shm, sizeof(ephem_shm_t));
+    return -1;
+}
+
+void ephem_client_detach(ephem_client_t *client){
+    atomic_store(&client->shm->slots[client->slot].owner, 0);
+    atomic_store(&client->shm->slots[client->slot].in_use, 0);
+    client->shm = NULL;
+}
+
+double ephem_client_ha(ephem_client_t *client, ephem_target_t target, int observer, double unix_time){
+    LATENCY_SCOPE(LAT_EPHEM_QUERY);
+    ephem_shm_t *shm = client->shm;
+    ephem_slot_t *slot = &shm->slots[client->slot];
+    if (observer < 0 || observer >= EPHEM_MAX_OBSERVERS){
+        errno = EINVAL;
+        return NAN;
+    }
+    uint32_t id = client->next_id++;
+    uint64_t deadline = now_ns() + EPHEM_TIMEOUT_MS * 1000000ULL;
+
+    uint32_t head = atomic_load_explicit(&slot->req_head, memory_order_relaxed);
+    while (head - atomic_load_explicit(&slot->req_tail, memory_order_acquire) >= EPHEM_QUEUE_LEN){
+        if (now_ns() >= deadline){
+            errno = ETIMEDOUT; // service is not draining
+            return NAN;
+        }
+        sched_yield();
+    }
+    ephem_request_t *r = &slot->req[head & QUEUE_MASK];
+    r->unix_time = unix_time;
+    r->id = id;
+    r->target = (uint8_t)target;
+    r->observer = (uint8_t)observer;
+    atomic_store_explicit(&slot->req_head, head + 1, memory_order_release);
+
+    atomic_fetch_add(&shm->work, 1);
+    if (atomic_load(&shm->service_waiting)) futex_wake(&shm->work);
+
+    int spins = 0;
+    while (1){
+        uint32_t tail = atomic_load_explicit(&slot->resp_tail, memory_order_relaxed);
+        uint32_t resp_head = atomic_load_explicit(&slot->resp_head, memory_order_acquire);
+        if (resp_head != tail){
+            ephem_response_t resp = slot->resp[tail & QUEUE_MASK];
+            atomic_store_explicit(&slot->resp_tail, tail + 1, memory_order_release);
+            if (resp.id != id) continue; // answer to an abandoned query
+            if (resp.status != 0){
+                errno = resp.status;
+                return NAN;
+            }
+            return resp.ha;
+        }
+        if (++spins < CLIENT_SPINS) continue;
+
+        atomic_store(&slot->client_waiting, 1);
+        int timed_out = atomic_load(&slot->resp_head) == tail && futex_wait_until(&slot->resp_head, tail, deadline) != 0;
+        atomic_store(&slot->client_waiting, 0);
+        if (timed_out){
+            errno = ETIMEDOUT; // a late answer is skipped by its id
+            return NAN;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+/*
+Ephemeris service: one thread(or process) owns CSPICE and answers hour angle queries
+from many trackers over shared memory. CSPICE is not thread-safe and every tracker
+loading its own kernels is a waste, so everybody asks the service instead.
+
+Each client gets a slot with two single-producer/single-consumer rings(requests in,
+responses out) in a POSIX shared memory object, waiting is done on futexes so it works
+between processes. Requests that hit the same (target, observer, time bucket) are only
+computed once, everything else picked up in one pass is computed as a batch.
+A shared answer is computed halfway between the earliest and latest time it was asked for,
+a lone query at exactly its time, and a cached one is only reused within EPHEM_BUCKET_S / 2.
+So every answer is for a time at most EPHEM_BUCKET_S / 2 from the requested one: 0.5 s,
+about 3.6e-5 rad or 0.03 encoder ticks of hour angle.
+*/
+
+#ifndef TRACKING_EPHEM_SERVICE_H
+#define TRACKING_EPHEM_SERVICE_H
+
+#include <stdint.h>
+#include "solar.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EPHEM_SHM_NAME "/callisto_ephem"
+#define EPHEM_MAX_CLIENTS 16
+#define EPHEM_MAX_OBSERVERS 4
+#define EPHEM_QUEUE_LEN 64 // per client and direction, power of two
+#define EPHEM_BUCKET_S 1.0 // queries inside the same second may share an answer
+#define EPHEM_TIMEOUT_MS 200 // longest a client waits for the service
+
+typedef enum {
+    EPHEM_SUN,
+    EPHEM_MOON,
+    EPHEM_TARGETS
+} ephem_target_t;
+
+typedef struct ephem_shm ephem_shm_t;
+
+typedef struct {
+    ephem_shm_t *shm;
+    int slot;
+    uint32_t next_id;
+} ephem_client_t;
+
+typedef struct {
+    uint64_t requests;  // queries answered
+    uint64_t computed;  // hour angles actually computed
+    uint64_t batches;   // passes of the service loop that had work
+} ephem_stats_t;
+
+// service side. Creates(or replaces) the shared memory object, observer 0 is SOLAR_SITE.
+ephem_shm_t *ephem_service_create(const char *name, double bucket_s);
+int ephem_service_add_observer(ephem_shm_t *shm, const observer_t *obs);
+// answers queries until ephem_service_stop(), ephemeris_init() has to be done by the caller
+void ephem_service_run(ephem_shm_t *shm);
+void ephem_service_stop(ephem_shm_t *shm);
+void ephem_service_destroy(ephem_shm_t *shm, const char *name);
+void ephem_service_stats(ephem_shm_t *shm, ephem_stats_t *stats);
+
+// client side, one client per thread. shm may be NULL to attach to name.
+// -1 if the service is not running or every slot is held by a live client,
+// slots of clients that exited without detaching are taken over.
+int ephem_client_attach(ephem_client_t *client, ephem_shm_t *shm, const char *name);
+void ephem_client_detach(ephem_client_t *client);
+// blocking query, returns the hour angle [rad]. NAN with errno ETIMEDOUT if no answer came within
+// EPHEM_TIMEOUT_MS, EINVAL if the service has no such observer or can not compute the target.
+double ephem_client_ha(ephem_client_t *client, ephem_target_t target, int observer, double unix_time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+/*
+Ephemeris daemon, owns CSPICE and answers the trackers over shared memory(see ephem_service.h).
+compile with: gcc -O2 -fopenmp-simd -o ephemd.exe ephemd.c ephem_service.c ephemeris.c clock.c solar.c latency.c -I/path/to/cspice/include -L/path/to/cspice/lib -lm -lcspice -lpthread -lrt
+or without CSPICE: gcc -O2 -fopenmp-simd -DEPHEMERIS_ANALYTIC -o ephemd.exe ephemd.c ephem_service.c ephemeris.c clock.c solar.c latency.c -lm -lpthread -lrt
+usage: ./ephemd.exe [bucket seconds]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include "ephemeris.h"
+#include "ephem_service.h"
+
+static ephem_shm_t *shm;
+
+static void on_signal(int sig){
+    (void)sig;
+    ephem_service_stop(shm);
+}
+
+int main(int argc, char **argv){
+    double bucket_s = EPHEM_BUCKET_S;
+    if (argc > 1) bucket_s = atof(argv[1]);
+
+    ephemeris_init();
+    shm = ephem_service_create(EPHEM_SHM_NAME, bucket_s);
+    if (shm == NULL){
+        perror("ephem_service_create");
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("ephemd serving %s, %.3f s buckets\n", EPHEM_SHM_NAME, bucket_s);
+
+    ephem_service_run(shm);
+
+    ephem_stats_t stats;
+    ephem_service_stats(shm, &stats);
+    printf("%llu queries, %llu computed, %llu batches\n",
+        (unsigned long long)stats.requests, (unsigned long long)stats.computed, (unsigned long long)stats.batches);
+    ephem_service_destroy(shm, EPHEM_SHM_NAME);
+    ephemeris_close();
+    return 0;
+}
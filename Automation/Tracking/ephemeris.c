@@ -0,0 +1,137 @@
+/*
+compile with: gcc -c ephemeris.c -I/path/to/cspice/include(link solar.c too, for observer_t and SOLAR_SITE)
+or without CSPICE: gcc -DEPHEMERIS_ANALYTIC -c ephemeris.c
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "clock.h"
+#include "tracker.h"
+#include "solar.h"
+#include "ephemeris.h"
+#include "latency.h"
+
+#ifdef EPHEMERIS_ANALYTIC
+
+void ephemeris_init(void){
+}
+
+void ephemeris_close(void){
+}
+
+SpiceDouble getEphemerisTime(void){
+    return clock_now_ns() / (double)NS_PER_SEC - SOLAR_UNIX_J2000;
+}
+
+SpiceDouble ephemerisTimeFromUnix(double unix_time){
+    return unix_time - SOLAR_UNIX_J2000;
+}
+
+SpiceDouble getHaFor(const char *target, const observer_t *obs, SpiceDouble ephemeris_time){
+    if (strcmp(target, "SUN") != 0) return NAN;
+    return solar_ha(ephemeris_time + SOLAR_UNIX_J2000, obs);
+}
+
+#else
+
+void ephemeris_init(void){
+    furnsh_c(KERNEL_DIR "naif0012.tls");    // leapseconds
+    furnsh_c(KERNEL_DIR "de435.bsp");      // planetary ephemeris
+    furnsh_c(KERNEL_DIR "pck00011.tpc");    // Earth orientation & shape
+    furnsh_c(KERNEL_DIR "earth_000101_260327_251229.bpc"); // earth binary pck
+}
+
+void ephemeris_close(void){
+    kclear_c();
+}
+
+SpiceDouble getEphemerisTime(void){
+    SpiceDouble ephemeris_time; // ephemeris time past J2000
+    time_t rawtime = clock_time();
+    char utc_str[80];
+
+    struct tm utc;
+    gmtime_r(&rawtime, &utc);
+    strftime(utc_str, sizeof(utc_str), "%Y-%m-%dT%H:%M:%S", &utc);
+    str2et_c(utc_str, &ephemeris_time);
+
+    return ephemeris_time;
+}
+
+SpiceDouble ephemerisTimeFromUnix(double unix_time){
+    SpiceDouble ephemeris_time;
+    time_t whole = (time_t)floor(unix_time);
+    char utc_str[80];
+
+    struct tm utc;
+    gmtime_r(&whole, &utc);
+    strftime(utc_str, sizeof(utc_str), "%Y-%m-%dT%H:%M:%S", &utc);
+    str2et_c(utc_str, &ephemeris_time);
+
+    return ephemeris_time + (unix_time - whole);
+}
+
+SpiceDouble getHaFor(const char *target, const observer_t *obs, SpiceDouble ephemeris_time){
+    // returns earth radii at different locations to account for ellipsoid shape. Loaded from kernel pck00011.tpc
+    SpiceDouble radii[3];
+    SpiceInt n;
+    bodvrd_c("EARTH", "RADII", 3, &n, radii);
+    SpiceDouble equatorial = radii[0];
+    SpiceDouble polar      = radii[2];
+    SpiceDouble flattening = (equatorial - polar) / equatorial;
+
+    // Observer vector in ITRF93 standard
+    SpiceDouble obs_itrf[3];
+    georec_c(obs->lon, obs->lat, obs->alt, equatorial, flattening, obs_itrf);
+
+    // Target position wrt Earth in J2000
+    SpiceDouble target_j2000[3];
+    SpiceDouble lt;
+    spkpos_c(target, ephemeris_time, "J2000", "LT+S", "EARTH", target_j2000, &lt);
+
+    // Observer vector in J2000
+    SpiceDouble xform[3][3]; // transformation matrix
+    SpiceDouble obs_j2000[3];
+    pxform_c("ITRF93", "J2000", ephemeris_time, xform);
+    mxv_c(xform, obs_itrf, obs_j2000);
+
+    // Topocentric target vector
+    SpiceDouble target_obs_j2000[3];
+    vsub_c(target_j2000, obs_j2000, target_obs_j2000); // vector subtraction
+
+    // RA
+    SpiceDouble ra  = atan2(target_obs_j2000[1], target_obs_j2000[0]);
+    if (ra < 0) ra += 2*PI;
+
+    // Greenwich sidereal RA (RA of ITRF x-axis in J2000)
+    SpiceDouble x_itrf[3] = {1.0, 0.0, 0.0};
+    SpiceDouble x_itrf_j2000[3];
+    mxv_c(xform, x_itrf, x_itrf_j2000); // matrix times vector
+    SpiceDouble ra_greenwich = atan2(x_itrf_j2000[1], x_itrf_j2000[0]);
+    if (ra_greenwich < 0) ra_greenwich += 2*PI;
+
+    // Local Sidereal Time
+    SpiceDouble lst = ra_greenwich + obs->lon;
+    lst = fmod(lst, 2*PI);
+    if (lst < 0) lst += 2*PI;
+
+    // Hour Angle
+    SpiceDouble ha = lst - ra;
+    while (ha <= -PI) ha += 2*PI;
+    while (ha > PI) ha -= 2*PI;
+
+    return ha;
+}
+
+#endif
+
+SpiceDouble getHaAt(SpiceDouble ephemeris_time){
+    return getHaFor("SUN", &SOLAR_SITE, ephemeris_time);
+}
+
+SpiceDouble getHa(void){
+    LATENCY_SCOPE(LAT_EPHEMERIS);
+    return getHaAt(getEphemerisTime());
+}
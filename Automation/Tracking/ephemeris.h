@@ -0,0 +1,44 @@
+/*
+Sun hour angle from CSPICE. CSPICE is not thread-safe, call these from one thread only.
+Build with -DEPHEMERIS_ANALYTIC to use the analytic engine in solar.c instead, then no
+CSPICE library or kernels are needed.
+*/
+
+#ifndef TRACKING_EPHEMERIS_H
+#define TRACKING_EPHEMERIS_H
+
+#ifdef EPHEMERIS_ANALYTIC
+typedef double SpiceDouble;
+#else
+#include "SpiceUsr.h"
+#endif
+
+#include "solar.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef KERNEL_DIR
+#define KERNEL_DIR "/home/kalisto/cspice/kernels/"
+#endif
+
+// loads the leapseconds, planetary ephemeris and Earth orientation kernels from KERNEL_DIR,
+// nothing to load with EPHEMERIS_ANALYTIC
+void ephemeris_init(void);
+void ephemeris_close(void);
+
+// ephemeris time past J2000 of the tracker clock(see clock.h)
+SpiceDouble getEphemerisTime(void);
+SpiceDouble ephemerisTimeFromUnix(double unix_time);
+// hour angle of any SPICE body("SUN", "MOON", ...) seen from obs, the analytic build only knows "SUN"
+SpiceDouble getHaFor(const char *target, const observer_t *obs, SpiceDouble ephemeris_time);
+// sun seen from the antenna site
+SpiceDouble getHaAt(SpiceDouble ephemeris_time);
+SpiceDouble getHa(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
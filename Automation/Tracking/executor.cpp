@@ -0,0 +1,110 @@
+/*
+compile with: g++ -std=c++20 -O2 -c executor.cpp
+*/
+
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "executor.hpp"
+
+#define MAX_EVENTS 16
+
+static std::system_error errno_error(const char *what){
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+Executor::Executor(){
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) throw errno_error("epoll_create1");
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_fd < 0) throw errno_error("eventfd");
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr; // the only event without a coroutine behind it
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &ev) < 0) throw errno_error("epoll_ctl");
+}
+
+Executor::~Executor(){
+    close(stop_fd);
+    close(epoll_fd);
+}
+
+void Executor::watch(int fd, std::coroutine_handle<> handle){
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = handle.address();
+    if ((size_t)fd >= registered.size()) registered.resize(fd + 1, false);
+    int op = registered[fd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epoll_fd, op, fd, &ev) < 0) throw errno_error("epoll_ctl");
+    registered[fd] = true;
+}
+
+void Executor::unwatch(int fd){
+    if (fd < 0 || (size_t)fd >= registered.size() || !registered[fd]) return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    registered[fd] = false;
+}
+
+void Executor::run(){
+    epoll_event events[MAX_EVENTS];
+    running = true;
+    while (running){
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0){
+            if (errno == EINTR) continue;
+            throw errno_error("epoll_wait");
+        }
+        wakeups_++;
+        for (int i = 0; i < n; i++){
+            if (events[i].data.ptr == nullptr){
+                running = false;
+                continue;
+            }
+            resumes_++;
+            std::coroutine_handle<>::from_address(events[i].data.ptr).resume();
+        }
+    }
+}
+
+void Executor::stop(){
+    uint64_t one = 1;
+    ssize_t ignored = write(stop_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+Timer::Timer(Executor &ex, uint64_t period_ns) : ex(ex){
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0) throw errno_error("timerfd_create");
+    if (period_ns){
+        itimerspec spec{};
+        spec.it_interval.tv_sec = period_ns / 1000000000ULL;
+        spec.it_interval.tv_nsec = period_ns % 1000000000ULL;
+        spec.it_value = spec.it_interval;
+        if (timerfd_settime(fd, 0, &spec, nullptr) < 0) throw errno_error("timerfd_settime");
+    }
+}
+
+Timer::~Timer(){
+    ex.unwatch(fd);
+    close(fd);
+}
+
+Timer &Timer::after(uint64_t ns){
+    itimerspec spec{};
+    if (ns == 0) ns = 1; // 0 would disarm
+    spec.it_value.tv_sec = ns / 1000000000ULL;
+    spec.it_value.tv_nsec = ns % 1000000000ULL;
+    if (timerfd_settime(fd, 0, &spec, nullptr) < 0) throw errno_error("timerfd_settime");
+    return *this;
+}
+
+uint64_t Timer::Awaiter::await_resume(){
+    uint64_t expirations = 0;
+    if (read(timer.fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return 0;
+    return expirations;
+}
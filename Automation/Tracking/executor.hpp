@@ -0,0 +1,92 @@
+/*
+Single threaded event loop for everything around the tracker that is not hard real time:
+ephemeris refresh, sensor polling, heater control, telemetry, homing. Tasks are C++20
+coroutines that co_await a timerfd tick or a readable fd(GPIO line events, signalfd, ...),
+so the whole station sleeps in one epoll_wait instead of one sleeping thread per job.
+Only the step/control loop keeps its own thread.
+*/
+
+#ifndef TRACKING_EXECUTOR_HPP
+#define TRACKING_EXECUTOR_HPP
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+// fire and forget coroutine, runs until its first co_await right away and then on the executor
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+class Executor {
+public:
+    Executor();
+    ~Executor();
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+    // dispatches events until stop()
+    void run();
+    // safe from any thread and from signal handlers
+    void stop();
+
+    // resumes the awaiting coroutine once fd is readable, one waiter per fd
+    struct Readable {
+        Executor &ex;
+        int fd;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { ex.watch(fd, handle); }
+        void await_resume() const noexcept {}
+    };
+    Readable readable(int fd) { return {*this, fd}; }
+    // call before closing an fd that was awaited, a reused fd number would get a stale MOD otherwise
+    void unwatch(int fd);
+
+    uint64_t wakeups() const { return wakeups_; }   // returns from epoll_wait
+    uint64_t resumes() const { return resumes_; }   // coroutines resumed
+
+private:
+    void watch(int fd, std::coroutine_handle<> handle);
+
+    int epoll_fd;
+    int stop_fd;
+    bool running = false;
+    std::vector<bool> registered; // by fd, ADD the first time and MOD after that
+    uint64_t wakeups_ = 0;
+    uint64_t resumes_ = 0;
+};
+
+// timerfd on CLOCK_MONOTONIC. co_await gives the number of expirations since the last one,
+// more than 1 means the task fell behind and ticks were merged.
+class Timer {
+public:
+    // period_ns 0 makes a one-shot timer that has to be armed with after()
+    Timer(Executor &ex, uint64_t period_ns = 0);
+    ~Timer();
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+
+    // (re)arms a one-shot expiry, co_await timer.after(ns) sleeps that long
+    Timer &after(uint64_t ns);
+
+    struct Awaiter {
+        Timer &timer;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { timer.ex.readable(timer.fd).await_suspend(handle); }
+        uint64_t await_resume();
+    };
+    Awaiter operator co_await() { return {*this}; }
+
+private:
+    Executor &ex;
+    int fd;
+};
+
+#endif
@@ -0,0 +1,379 @@
+/*
+Context switches and CPU use of the station's thread layouts, hardware replaced by fakes:
+  threads:  main.c as it is(1 kHz guidance thread that prints every cycle, stepper thread polling
+            every 1 ms, wiringPi ISR threads for the encoder) plus the Python sensor and heater loops
+  executor: station.cpp(one control thread for PID + steps that sleeps once on target, encoder
+            edges and everything else as coroutines on epoll)
+Both track a setpoint moving at sidereal speed, one tick every 17.28 s, with the loop bodies
+of tracker.c. Each motor step moves the fake encoder by one quadrature state.
+compile with: gcc -O2 -c tracker.c
+              g++ -std=c++20 -O2 -o executor_bench.exe executor_bench.cpp executor.cpp tracker.o -lm -lpthread
+usage: ./executor_bench.exe [seconds per layout]
+*/
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include "tracker.h"
+#include "executor.hpp"
+
+constexpr uint64_t MS = 1000000ULL;
+constexpr uint64_t SEC = 1000000000ULL;
+constexpr double SIDEREAL_TICK_S = 86400.0 / TICKS_PER_REV;
+
+static std::atomic<bool> running;
+static uint64_t start_ns;
+static std::mutex stop_lock;
+static std::condition_variable stop_cv; // sleeps that have to end early when the run is over
+static std::atomic<Executor *> stop_executor{nullptr};
+static int control_wake; // eventfd, wakes a settled executor::controlThread
+
+static uint64_t mono_ns(){
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * SEC + ts.tv_nsec;
+}
+
+static void sleep_ns(uint64_t ns){
+    timespec ts = {(time_t)(ns / SEC), (long)(ns % SEC)};
+    nanosleep(&ts, nullptr);
+}
+
+static void sleep_until(uint64_t deadline_ns){
+    timespec ts = {(time_t)(deadline_ns / SEC), (long)(deadline_ns % SEC)};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+}
+
+// fake ephemeris: the sun moves one tick every SIDEREAL_TICK_S
+static long fake_setpoint(){
+    return (long)((mono_ns() - start_ns) / 1e9 / SIDEREAL_TICK_S);
+}
+
+static void wake_control(){
+    uint64_t one = 1;
+    ssize_t ignored = write(control_wake, &one, sizeof(one));
+    (void)ignored;
+}
+
+// next quadrature state in the given direction, (a << 1) | b
+static uint8_t quadrature_step(uint8_t state, int forward){
+    static const uint8_t FORWARD[4] = {0, 2, 3, 1};
+    static const uint8_t PHASE[4] = {0, 3, 1, 2}; // inverse of FORWARD
+    return FORWARD[(PHASE[state] + (forward ? 1 : 3)) & 3];
+}
+
+// fake sensor read, roughly what formatting a few I2C readings costs
+static double fake_sensors(){
+    volatile double x = 0;
+    for (int i = 0; i < 2000; i++) x = x + std::sqrt((double)i);
+    return x;
+}
+
+// --- current layout ---
+namespace threads {
+
+std::mutex lock;
+encoder_t encoder;
+uint8_t shaft_state = 0; // quadrature state the fake encoder shows
+float target_step_rate = 0;
+int encoder_event; // eventfd standing in for the GPIO edge the wiringPi ISR thread waits on
+FILE *console;
+
+void isrThread(){
+    while (running){
+        uint64_t count;
+        if (read(encoder_event, &count, sizeof(count)) != sizeof(count)) continue;
+        std::lock_guard<std::mutex> guard(lock);
+        encoder_update(&encoder, shaft_state); // digitalRead of both channels
+    }
+}
+
+void stepperThread(){
+    stepper_t stepper = {0, 0, 0};
+    while (running){
+        float rate;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            rate = target_step_rate;
+        }
+        int delay_us = stepper_edge(&stepper, rate);
+        if (delay_us == 0){
+            sleep_ns(STEP_IDLE_US * 1000ULL); // usleep(1000)
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            shaft_state = quadrature_step(shaft_state, stepper.forward); // the step moves the encoder
+        }
+        uint64_t one = 1;
+        ssize_t ignored = write(encoder_event, &one, sizeof(one));
+        (void)ignored;
+        sleep_ns(delay_us * 1000ULL);
+        delay_us = stepper_edge(&stepper, rate);
+        sleep_ns(delay_us * 1000ULL);
+    }
+}
+
+void guidanceThread(){
+    guidance_t guidance;
+    guidance_init(&guidance, 10.0, 0.0, 0.0);
+    uint64_t next = mono_ns();
+    while (running){
+        if (guidance_refresh_due(&guidance)) guidance.setpoint = fake_setpoint();
+        long enc;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            enc = encoder.ticks;
+        }
+        float rate = guidance_control(&guidance, enc, PID_PERIOD / 1000.0);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            target_step_rate = rate;
+        }
+        fprintf(console, "encoder_ticks: %ld;   error: %f;   output/step_rate:%f   ha: %ld\n", enc, guidance.error, rate, guidance.setpoint);
+        next += (uint64_t)(PID_PERIOD * MS);
+        sleep_until(next);
+    }
+}
+
+void pythonLoop(uint64_t period_ns){
+    std::unique_lock<std::mutex> guard(stop_lock);
+    while (running){
+        fprintf(console, "%f\n", fake_sensors());
+        stop_cv.wait_for(guard, std::chrono::nanoseconds(period_ns), []{ return !running; }); // sleep(period)
+    }
+}
+
+void run(Executor &){
+    encoder_init(&encoder, shaft_state);
+    console = fopen("/dev/null", "w");
+    setvbuf(console, nullptr, _IOLBF, 0); // a terminal is line buffered
+    encoder_event = eventfd(0, EFD_SEMAPHORE);
+    std::vector<std::thread> all;
+    all.emplace_back(stepperThread);
+    all.emplace_back(guidanceThread);
+    for (int i = 0; i < 3; i++) all.emplace_back(isrThread); // ENC_A, ENC_B, limit switch
+    all.emplace_back(pythonLoop, 1000 * MS);                 // sensing.py
+    all.emplace_back(pythonLoop, 60000 * MS);                // heater control
+    while (running) sleep_ns(10 * MS);
+    uint64_t wake = 3;
+    ssize_t ignored = write(encoder_event, &wake, sizeof(wake)); // let the ISR threads see running == false
+    (void)ignored;
+    for (std::thread &t : all) t.join();
+    close(encoder_event);
+    fclose(console);
+}
+
+}
+
+// --- executor layout ---
+namespace executor {
+
+std::atomic<long> setpoint{0}, encoder_ticks{0};
+std::vector<double> telemetry;
+encoder_t encoder; // executor thread only
+int encoder_pipe[2]; // quadrature states, standing in for the GPIO line event queue
+
+// same as wait_for_change in station.cpp
+void waitForChange(long ticks, long target){
+    uint64_t count;
+    while (read(control_wake, &count, sizeof(count)) > 0) continue;
+    if (!running || encoder_ticks != ticks || setpoint != target) return;
+    pollfd pfd = {control_wake, POLLIN, 0};
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR) continue;
+}
+
+// station.cpp's controlThread without the homing rate and the GPIO writes
+void controlThread(){
+    guidance_t guidance;
+    guidance_init(&guidance, 10.0, 0.0, 0.0);
+    stepper_t stepper = {0, 0, 0};
+    uint8_t shaft_state = 0;
+    float rate = 0;
+    uint64_t next_pid = mono_ns(), next_edge = UINT64_MAX;
+    while (running){
+        uint64_t now = mono_ns();
+        bool settled = false;
+        long ticks = 0;
+        if (now >= next_pid){
+            ticks = encoder_ticks;
+            float prev_error = guidance.error;
+            guidance.setpoint = setpoint;
+            rate = guidance_control(&guidance, ticks, PID_PERIOD / 1000.0);
+            next_pid += (uint64_t)(PID_PERIOD * MS);
+            if (next_edge == UINT64_MAX && step_half_period_us(rate) != 0) next_edge = now;
+            settled = next_edge == UINT64_MAX && guidance.error == 0 && prev_error == 0;
+        }
+        if (settled){
+            waitForChange(ticks, guidance.setpoint);
+            next_pid = mono_ns();
+            continue;
+        }
+        if (now >= next_edge){
+            int delay_us = stepper_edge(&stepper, rate);
+            if (delay_us == 0){
+                next_edge = UINT64_MAX;
+            } else {
+                if (stepper.high){
+                    // the step moves the encoder, the kernel queues the edge
+                    shaft_state = quadrature_step(shaft_state, stepper.forward);
+                    ssize_t ignored = write(encoder_pipe[1], &shaft_state, 1);
+                    (void)ignored;
+                }
+                next_edge = now + delay_us * 1000ULL;
+            }
+        }
+        sleep_until(next_edge < next_pid ? next_edge : next_pid);
+    }
+}
+
+Task encoderEvents(Executor &ex){
+    encoder_init(&encoder, 0);
+    while (running){
+        co_await ex.readable(encoder_pipe[0]);
+        long before = encoder.ticks;
+        uint8_t states[64];
+        ssize_t n;
+        while ((n = read(encoder_pipe[0], states, sizeof(states))) > 0){
+            for (ssize_t i = 0; i < n; i++) encoder_update(&encoder, states[i]);
+        }
+        if (encoder.ticks != before){
+            encoder_ticks = encoder.ticks;
+            wake_control();
+        }
+    }
+}
+
+Task ephemerisRefresh(Executor &ex){
+    Timer timer(ex, (uint64_t)(PID_PERIOD * MS) * TARGET_POSITION_UPDATE_MULTIPLIER);
+    while (running){
+        long target = fake_setpoint();
+        if (setpoint.exchange(target) != target) wake_control();
+        co_await timer;
+    }
+}
+
+Task sensorPolling(Executor &ex){
+    Timer period(ex, 1000 * MS), conversion(ex);
+    while (running){
+        co_await conversion.after(10 * MS); // BME280 forced conversion
+        telemetry.push_back(fake_sensors());
+        co_await period;
+    }
+}
+
+Task heaterControl(Executor &ex){
+    Timer timer(ex, 60000 * MS);
+    while (running){
+        fake_sensors();
+        co_await timer;
+    }
+}
+
+Task telemetryFlush(Executor &ex){
+    Timer timer(ex, 10000 * MS);
+    FILE *out = fopen("/dev/null", "w");
+    while (running){
+        co_await timer;
+        for (double v : telemetry) fprintf(out, "%f\n", v);
+        fflush(out);
+        telemetry.clear();
+    }
+}
+
+uint64_t wakeups;
+
+void run(Executor &ex){
+    setpoint = 0;
+    encoder_ticks = 0;
+    if (pipe2(encoder_pipe, O_CLOEXEC | O_NONBLOCK) < 0) return;
+    std::thread control(controlThread);
+    encoderEvents(ex);
+    ephemerisRefresh(ex);
+    sensorPolling(ex);
+    heaterControl(ex);
+    telemetryFlush(ex);
+    ex.run();
+    control.join();
+    ex.unwatch(encoder_pipe[0]);
+    close(encoder_pipe[0]);
+    close(encoder_pipe[1]);
+    wakeups = ex.wakeups();
+}
+
+}
+
+struct Usage {
+    double wall, cpu;
+    long voluntary, involuntary;
+};
+
+static Usage measure(void (*layout)(Executor &), double seconds){
+    rusage before, after;
+    Executor ex; // only the executor layout runs it
+    running = true;
+    start_ns = mono_ns();
+    stop_executor = &ex; // before the stopper can fire
+    std::thread stopper([seconds]{
+        sleep_ns((uint64_t)(seconds * SEC));
+        std::lock_guard<std::mutex> guard(stop_lock);
+        running = false;
+        stop_cv.notify_all();
+        wake_control();
+        stop_executor.load()->stop();
+    });
+    getrusage(RUSAGE_SELF, &before);
+    uint64_t t0 = mono_ns();
+    layout(ex);
+    uint64_t t1 = mono_ns();
+    getrusage(RUSAGE_SELF, &after);
+    stopper.join();
+    stop_executor = nullptr;
+
+    auto tv = [](const timeval &t){ return t.tv_sec + t.tv_usec / 1e6; };
+    Usage u;
+    u.wall = (t1 - t0) / 1e9;
+    u.cpu = tv(after.ru_utime) - tv(before.ru_utime) + tv(after.ru_stime) - tv(before.ru_stime);
+    u.voluntary = after.ru_nvcsw - before.ru_nvcsw;
+    u.involuntary = after.ru_nivcsw - before.ru_nivcsw;
+    return u;
+}
+
+static void report(const char *name, const Usage &u, int cpus){
+    printf("%-9s %12.0f %12.0f %12.0f %9.2f%% %9.2f%%\n", name,
+        (u.voluntary + u.involuntary) / u.wall, u.voluntary / u.wall, u.involuntary / u.wall,
+        100.0 * u.cpu / u.wall, 100.0 - 100.0 * u.cpu / (u.wall * cpus));
+}
+
+int main(int argc, char **argv){
+    double seconds = 10;
+    if (argc > 1) seconds = atof(argv[1]);
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    control_wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    printf("%.0f s per layout, %d CPUs\n", seconds, cpus);
+    printf("%-9s %12s %12s %12s %10s %10s\n", "layout", "switches/s", "voluntary/s", "involunt./s", "CPU", "idle CPU");
+    Usage t = measure(threads::run, seconds);
+    report("threads", t, cpus);
+    Usage e = measure(executor::run, seconds);
+    report("executor", e, cpus);
+    printf("executor loop woke %.1f times/s, the rest is the control thread\n", executor::wakeups / e.wall);
+    printf("encoder at the end: threads %ld, executor %ld, setpoint %ld\n",
+        threads::encoder.ticks, executor::encoder.ticks, fake_setpoint());
+    printf("context switches %.1fx fewer, CPU time %.1fx less\n",
+        (double)(t.voluntary + t.involuntary) / (e.voluntary + e.involuntary), t.cpu / e.cpu);
+    return 0;
+}
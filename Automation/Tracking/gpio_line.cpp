@@ -0,0 +1,79 @@
+/*
+compile with: g++ -std=c++20 -O2 -c gpio_line.cpp
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "gpio_line.hpp"
+
+static std::system_error errno_error(const char *what){
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+GpioLines::GpioLines(std::initializer_list<unsigned> offsets, Mode mode, const char *consumer, int initial, const char *chip){
+    int chip_fd = open(chip, O_RDONLY | O_CLOEXEC);
+    if (chip_fd < 0) throw errno_error(chip);
+
+    gpio_v2_line_request req;
+    memset(&req, 0, sizeof(req));
+    for (unsigned offset : offsets) req.offsets[req.num_lines++] = offset;
+    strncpy(req.consumer, consumer, sizeof(req.consumer) - 1);
+
+    switch (mode){
+    case OUTPUT:
+        req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+        // initial level of every line
+        req.config.num_attrs = 1;
+        req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        req.config.attrs[0].attr.values = initial ? (1ULL << req.num_lines) - 1 : 0;
+        req.config.attrs[0].mask = (1ULL << req.num_lines) - 1;
+        break;
+    case INPUT:
+        req.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+        break;
+    case BOTH_EDGES:
+        req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        break;
+    case FALLING_EDGE:
+        req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        break;
+    }
+    if (mode == BOTH_EDGES || mode == FALLING_EDGE) req.event_buffer_size = 256; // edges the kernel keeps for us
+
+    int result = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req);
+    int error = errno;
+    close(chip_fd);
+    if (result < 0){
+        errno = error;
+        throw errno_error("GPIO_V2_GET_LINE_IOCTL");
+    }
+    line_fd = req.fd;
+    fcntl(line_fd, F_SETFL, fcntl(line_fd, F_GETFL) | O_NONBLOCK);
+}
+
+GpioLines::~GpioLines(){
+    close(line_fd);
+}
+
+void GpioLines::set(unsigned index, int value){
+    gpio_v2_line_values values;
+    values.mask = 1ULL << index;
+    values.bits = value ? 1ULL << index : 0;
+    ioctl(line_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+}
+
+int GpioLines::get(unsigned index){
+    gpio_v2_line_values values;
+    values.mask = 1ULL << index;
+    values.bits = 0;
+    if (ioctl(line_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) return -1;
+    return (values.bits >> index) & 1;
+}
+
+bool GpioLines::read_event(gpio_v2_line_event &event){
+    return read(line_fd, &event, sizeof(event)) == sizeof(event);
+}
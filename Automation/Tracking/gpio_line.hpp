@@ -0,0 +1,39 @@
+/*
+GPIO lines through the kernel character device(/dev/gpiochipN, uAPI v2) instead of wiringPi.
+Input lines with edge detection give an fd that becomes readable when the kernel has queued
+timestamped edges, so nobody needs an ISR thread or a polling loop to wait for them.
+*/
+
+#ifndef TRACKING_GPIO_LINE_HPP
+#define TRACKING_GPIO_LINE_HPP
+
+#include <cstdint>
+#include <initializer_list>
+#include <linux/gpio.h>
+
+#define GPIO_CHIP "/dev/gpiochip0" // Raspberry Pi header, offsets are BCM numbers
+
+class GpioLines {
+public:
+    enum Mode { OUTPUT, INPUT, BOTH_EDGES, FALLING_EDGE };
+
+    // all lines get the same mode, outputs start at the given level
+    GpioLines(std::initializer_list<unsigned> offsets, Mode mode, const char *consumer, int initial = 0, const char *chip = GPIO_CHIP);
+    ~GpioLines();
+    GpioLines(const GpioLines &) = delete;
+    GpioLines &operator=(const GpioLines &) = delete;
+
+    int fd() const { return line_fd; }
+
+    // index is the position in the offsets list
+    void set(unsigned index, int value);
+    int get(unsigned index);
+
+    // next queued edge, false when there is none(the fd is non-blocking)
+    bool read_event(gpio_v2_line_event &event);
+
+private:
+    int line_fd;
+};
+
+#endif
@@ -0,0 +1,201 @@
+/*
+compile with: gcc -O2 -c latency.c
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include "latency.h"
+
+#define SUB_BITS 8                  // 2^SUB_BITS linear values before the first doubling
+#define SUB_HALF (1 << (SUB_BITS - 1))
+#define MAX_BITS 40                 // values up to 2^40 ns, about 18 minutes
+#define BUCKETS ((MAX_BITS - SUB_BITS + 2) * SUB_HALF)
+
+typedef struct {
+    _Atomic uint64_t counts[BUCKETS];
+    _Atomic uint64_t total;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t min;
+    _Atomic uint64_t max;
+} histogram_t;
+
+static const char *STAGE_NAMES[LAT_STAGES] = {
+    "encoderISR",
+    "edge->ISR",
+    "pid_update",
+    "step overrun",
+    "getHa",
+    "ephem query",
+};
+
+static histogram_t histograms[LAT_STAGES];
+static double ns_per_tick = 1.0;
+
+static const char *dump_path;
+static sigset_t dump_signals;
+
+#if defined(LATENCY_USE_CYCLES) && defined(__x86_64__)
+static uint64_t raw_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+void latency_init(void){
+#if defined(LATENCY_USE_CYCLES) && defined(__aarch64__)
+    uint64_t freq;
+    __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    ns_per_tick = 1e9 / (double)freq;
+#elif defined(LATENCY_USE_CYCLES) && defined(__x86_64__)
+    // TSC rate is not exposed, measure it against the raw monotonic clock
+    struct timespec wait = {0, 20000000};
+    uint64_t ns0 = raw_ns(), t0 = latency_now();
+    nanosleep(&wait, NULL);
+    uint64_t ns1 = raw_ns(), t1 = latency_now();
+    ns_per_tick = (double)(ns1 - ns0) / (double)(t1 - t0);
+#else
+    ns_per_tick = 1.0;
+#endif
+    latency_reset();
+}
+
+uint64_t latency_to_ns(uint64_t ticks){
+    return (uint64_t)(ticks * ns_per_tick);
+}
+
+static int bucket_of(uint64_t v){
+    if (v < (1u << SUB_BITS)) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    if (msb >= MAX_BITS) return BUCKETS - 1;
+    int shift = msb - SUB_BITS + 1;
+    return shift * SUB_HALF + (int)(v >> shift);
+}
+
+// highest value that still falls into the bucket
+static uint64_t bucket_value(int index){
+    if (index < (1 << SUB_BITS)) return (uint64_t)index;
+    int shift = index / SUB_HALF - 1;
+    uint64_t sub = (uint64_t)(index - shift * SUB_HALF);
+    return ((sub + 1) << shift) - 1;
+}
+
+void latency_record_ns(latency_stage_t stage, uint64_t ns){
+    histogram_t *h = &histograms[stage];
+    atomic_fetch_add_explicit(&h->counts[bucket_of(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->total, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, ns, memory_order_relaxed);
+
+    uint64_t cur = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (ns > cur && !atomic_compare_exchange_weak_explicit(&h->max, &cur, ns, memory_order_relaxed, memory_order_relaxed)){
+        continue;
+    }
+    cur = atomic_load_explicit(&h->min, memory_order_relaxed);
+    while (ns < cur && !atomic_compare_exchange_weak_explicit(&h->min, &cur, ns, memory_order_relaxed, memory_order_relaxed)){
+        continue;
+    }
+}
+
+void latency_record_ticks(latency_stage_t stage, uint64_t ticks){
+    latency_record_ns(stage, latency_to_ns(ticks));
+}
+
+void latency_reset(void){
+    for (int s = 0; s < LAT_STAGES; s++){
+        histogram_t *h = &histograms[s];
+        for (int i = 0; i < BUCKETS; i++) atomic_store_explicit(&h->counts[i], 0, memory_order_relaxed);
+        atomic_store(&h->total, 0);
+        atomic_store(&h->sum, 0);
+        atomic_store(&h->min, UINT64_MAX);
+        atomic_store(&h->max, 0);
+    }
+}
+
+// value below which the given fraction of samples lies, from a copy of the counts
+static uint64_t percentile(const uint64_t *counts, uint64_t total, double fraction){
+    uint64_t rank = (uint64_t)(fraction * total + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++){
+        seen += counts[i];
+        if (seen >= rank) return bucket_value(i);
+    }
+    return bucket_value(BUCKETS - 1);
+}
+
+uint64_t latency_percentile(latency_stage_t stage, double fraction){
+    static uint64_t counts[BUCKETS]; // only used by the reporting thread
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKETS; i++){
+        counts[i] = atomic_load_explicit(&histograms[stage].counts[i], memory_order_relaxed);
+        total += counts[i];
+    }
+    return total ? percentile(counts, total, fraction) : 0;
+}
+
+void latency_dump(FILE *out){
+    static uint64_t counts[BUCKETS]; // only used by the dumping thread
+
+    fprintf(out, "%-14s %10s %10s %10s %10s %10s %10s %10s   [ns]\n",
+        "stage", "count", "min", "mean", "p50", "p99", "p99.9", "max");
+    for (int s = 0; s < LAT_STAGES; s++){
+        histogram_t *h = &histograms[s];
+        uint64_t total = 0;
+        for (int i = 0; i < BUCKETS; i++){
+            counts[i] = atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0) continue;
+
+        uint64_t sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+        uint64_t recorded = atomic_load_explicit(&h->total, memory_order_relaxed);
+        fprintf(out, "%-14s %10llu %10llu %10llu %10llu %10llu %10llu %10llu\n",
+            STAGE_NAMES[s],
+            (unsigned long long)total,
+            (unsigned long long)atomic_load_explicit(&h->min, memory_order_relaxed),
+            (unsigned long long)(recorded ? sum / recorded : 0),
+            (unsigned long long)percentile(counts, total, 0.50),
+            (unsigned long long)percentile(counts, total, 0.99),
+            (unsigned long long)percentile(counts, total, 0.999),
+            (unsigned long long)atomic_load_explicit(&h->max, memory_order_relaxed));
+    }
+}
+
+int latency_dump_file(const char *path){
+    FILE *out = fopen(path, "a");
+    if (out == NULL) return -1;
+
+    time_t now = time(NULL);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", gmtime(&now));
+    fprintf(out, "--- latency snapshot %s UTC ---\n", stamp);
+    latency_dump(out);
+    fclose(out);
+    return 0;
+}
+
+static void *dump_thread(void *arg){
+    (void)arg;
+    while (1){
+        int sig;
+        if (sigwait(&dump_signals, &sig) == 0){
+            latency_dump_file(dump_path);
+        }
+    }
+    return NULL;
+}
+
+int latency_dump_on_signal(int sig, const char *path){
+    pthread_t thread;
+    dump_path = path;
+    sigemptyset(&dump_signals);
+    sigaddset(&dump_signals, sig);
+    if (pthread_sigmask(SIG_BLOCK, &dump_signals, NULL) != 0) return -1;
+    if (pthread_create(&thread, NULL, dump_thread, NULL) != 0) return -1;
+    pthread_detach(thread);
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+Latency probes for the control stack. Each stage has a lock-free HDR style histogram
+(log buckets split in 128 linear sub-buckets, under 1% error) that probes from any
+thread can record into, and that can be dumped with p50/p99/p99.9/max at any time.
+
+Probes only exist when built with -DLATENCY_PROBES, otherwise every macro below is empty.
+Timestamps come from CLOCK_MONOTONIC_RAW, or from the CPU counter(cntvct_el0 / rdtsc)
+when also built with -DLATENCY_USE_CYCLES. latency_bench.c measures what a probe costs.
+*/
+
+#ifndef TRACKING_LATENCY_H
+#define TRACKING_LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    LAT_ISR,        // encoderISR run time
+    LAT_ISR_EDGE,   // encoder edge to callback, where the GPIO library gives an edge timestamp
+    LAT_PID,        // pid_update compute time
+    LAT_STEP,       // step half period overrun, actual minus the delay_us asked for
+    LAT_EPHEMERIS,  // getHa() duration
+    LAT_EPHEM_QUERY, // ephemeris service round trip, ephem_client_ha()
+    LAT_STAGES
+} latency_stage_t;
+
+typedef struct {
+    latency_stage_t stage;
+    uint64_t start;
+} latency_scope_t;
+
+static inline uint64_t latency_now(void){
+#if defined(LATENCY_USE_CYCLES) && defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#elif defined(LATENCY_USE_CYCLES) && defined(__x86_64__)
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// sets up the counter to ns conversion, call once before the first probe
+void latency_init(void);
+uint64_t latency_to_ns(uint64_t ticks);
+
+void latency_record_ns(latency_stage_t stage, uint64_t ns);
+void latency_record_ticks(latency_stage_t stage, uint64_t ticks);
+void latency_reset(void);
+// value below which the given fraction of the stage's samples lies [ns]
+uint64_t latency_percentile(latency_stage_t stage, double fraction);
+
+// writes a snapshot of every stage that has samples
+void latency_dump(FILE *out);
+int latency_dump_file(const char *path);
+// starts a thread that appends a snapshot to path every time sig arrives(e.g. kill -USR1).
+// Blocks sig in the calling thread, so call it before any other thread is created.
+int latency_dump_on_signal(int sig, const char *path);
+
+static inline void latency_scope_end(latency_scope_t *scope){
+    latency_record_ticks(scope->stage, latency_now() - scope->start);
+}
+
+#define LATENCY_CAT2(a, b) a##b
+#define LATENCY_CAT(a, b) LATENCY_CAT2(a, b)
+
+#ifdef LATENCY_PROBES
+
+// times from here to the end of the enclosing block
+#define LATENCY_SCOPE(stage) \
+    latency_scope_t LATENCY_CAT(latency_scope_, __LINE__) __attribute__((cleanup(latency_scope_end))) = {(stage), latency_now()}
+// remember a start point and later record the time since it
+#define LATENCY_MARK(name) uint64_t name = latency_now()
+#define LATENCY_SINCE(stage, name) latency_record_ticks((stage), latency_now() - (name))
+// record how much longer than expected_ns it took since the mark, 0 if it was on time
+#define LATENCY_OVERRUN(stage, name, expected_ns) do { \
+        uint64_t latency_elapsed_ = latency_to_ns(latency_now() - (name)); \
+        latency_record_ns((stage), latency_elapsed_ > (expected_ns) ? latency_elapsed_ - (expected_ns) : 0); \
+    } while (0)
+#define LATENCY_RECORD_NS(stage, ns) latency_record_ns((stage), (ns))
+#define LATENCY_INIT() latency_init()
+#define LATENCY_DUMP_ON_SIGNAL(sig, path) latency_dump_on_signal((sig), (path))
+#define LATENCY_DUMP_FILE(path) latency_dump_file(path)
+
+#else
+
+#define LATENCY_SCOPE(stage) do {} while (0)
+#define LATENCY_MARK(name) do {} while (0)
+#define LATENCY_SINCE(stage, name) do {} while (0)
+#define LATENCY_OVERRUN(stage, name, expected_ns) do {} while (0)
+#define LATENCY_RECORD_NS(stage, ns) do {} while (0)
+#define LATENCY_INIT() do {} while (0)
+#define LATENCY_DUMP_ON_SIGNAL(sig, path) do {} while (0)
+#define LATENCY_DUMP_FILE(path) do {} while (0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
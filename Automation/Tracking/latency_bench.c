@@ -0,0 +1,78 @@
+/*
+What one latency probe costs, and a sample snapshot.
+compile with: gcc -O2 -DLATENCY_PROBES -o latency_bench.exe latency_bench.c latency.c -lpthread
+or with the CPU counter as time source: gcc -O2 -DLATENCY_PROBES -DLATENCY_USE_CYCLES -o latency_bench.exe latency_bench.c latency.c -lpthread
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "latency.h"
+
+#ifndef LATENCY_PROBES
+
+int main(void){
+    printf("built without -DLATENCY_PROBES, every probe compiles to nothing\n");
+    return 0;
+}
+
+#else
+
+#define ITERATIONS 5000000
+#define SLEEPS 2000
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// keeps the compiler from dropping or merging the loop bodies
+#define BARRIER() __asm__ volatile("" ::: "memory")
+
+int main(void){
+    latency_init();
+#ifdef LATENCY_USE_CYCLES
+    printf("time source: CPU counter, %.3f ns per tick\n", (double)latency_to_ns(1000000) / 1e6);
+#else
+    printf("time source: CLOCK_MONOTONIC_RAW\n");
+#endif
+
+    double start = now_s();
+    for (int i = 0; i < ITERATIONS; i++){
+        BARRIER();
+    }
+    double empty = now_s() - start;
+
+    volatile uint64_t sink = 0;
+    start = now_s();
+    for (int i = 0; i < ITERATIONS; i++){
+        sink += latency_now();
+        BARRIER();
+    }
+    double timestamp = now_s() - start;
+
+    start = now_s();
+    for (int i = 0; i < ITERATIONS; i++){
+        LATENCY_SCOPE(LAT_PID);
+        BARRIER();
+    }
+    double scope = now_s() - start;
+
+    printf("timestamp read        %7.1f ns\n", (timestamp - empty) / ITERATIONS * 1e9);
+    printf("LATENCY_SCOPE probe   %7.1f ns (two timestamps + histogram update)\n", (scope - empty) / ITERATIONS * 1e9);
+
+    // sample snapshot: how late 100 us sleeps wake up, like the stepper thread's
+    latency_reset();
+    struct timespec wait = {0, 100000};
+    for (int i = 0; i < SLEEPS; i++){
+        LATENCY_MARK(sleep_start);
+        nanosleep(&wait, NULL);
+        LATENCY_OVERRUN(LAT_STEP, sleep_start, 100000);
+    }
+    printf("\n%d x nanosleep(100 us) overrun:\n", SLEEPS);
+    latency_dump(stdout);
+    return 0;
+}
+
+#endif
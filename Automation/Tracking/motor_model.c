@@ -0,0 +1,49 @@
+/*
+compile with: gcc -c motor_model.c
+*/
+
+#include <math.h>
+#include "motor_model.h"
+
+// A/B states in the order that encoder_transition() counts as +1
+static const uint8_t QUADRATURE[4] = {0, 2, 3, 1};
+
+static uint8_t state_of(long count){
+    return QUADRATURE[((count % 4) + 4) % 4];
+}
+
+void motor_model_init(motor_model_t *m, double ticks_per_step, double start_ticks){
+    m->ticks_per_step = ticks_per_step;
+    m->position = start_ticks;
+    m->encoder_count = (long)floor(start_ticks);
+    m->dir = 1;
+    m->steps = 0;
+}
+
+void motor_model_set_dir(motor_model_t *m, int dir){
+    m->dir = dir ? 1 : 0;
+}
+
+// emit every encoder state between the shown count and the shaft position
+static void follow(motor_model_t *m, encoder_edge_cb cb, void *ctx){
+    long target = (long)floor(m->position);
+    while (m->encoder_count != target){
+        m->encoder_count += (target > m->encoder_count) ? 1 : -1;
+        if (cb) cb(state_of(m->encoder_count), ctx);
+    }
+}
+
+void motor_model_step(motor_model_t *m, encoder_edge_cb cb, void *ctx){
+    m->position += m->dir ? m->ticks_per_step : -m->ticks_per_step;
+    m->steps++;
+    follow(m, cb, ctx);
+}
+
+void motor_model_push(motor_model_t *m, double ticks, encoder_edge_cb cb, void *ctx){
+    m->position += ticks;
+    follow(m, cb, ctx);
+}
+
+uint8_t motor_model_encoder_state(const motor_model_t *m){
+    return state_of(m->encoder_count);
+}
@@ -0,0 +1,39 @@
+/*
+Simple stepper + quadrature encoder model for running the tracker without hardware.
+Every step pulse moves the shaft by ticks_per_step encoder ticks and the encoder
+emits every A/B state it passes through, same as the real one would.
+*/
+
+#ifndef TRACKING_MOTOR_MODEL_H
+#define TRACKING_MOTOR_MODEL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// called for every encoder edge, state is (a << 1) | b
+typedef void (*encoder_edge_cb)(uint8_t state, void *ctx);
+
+typedef struct {
+    double ticks_per_step; // encoder ticks the output shaft moves per motor step
+    double position;       // output shaft position in encoder ticks, never wrapped
+    long encoder_count;    // position the encoder disk currently shows, never wrapped
+    int dir;               // level on DIR_PIN, 1 moves towards positive ticks
+    long steps;            // step pulses seen so far
+} motor_model_t;
+
+void motor_model_init(motor_model_t *m, double ticks_per_step, double start_ticks);
+void motor_model_set_dir(motor_model_t *m, int dir);
+// rising edge on STEP_PIN
+void motor_model_step(motor_model_t *m, encoder_edge_cb cb, void *ctx);
+// shaft moved by something else(wind, a hand), no step pulse
+void motor_model_push(motor_model_t *m, double ticks, encoder_edge_cb cb, void *ctx);
+uint8_t motor_model_encoder_state(const motor_model_t *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,85 @@
+/*
+compile with: gcc -O2 -c quadrature.c
+*/
+
+#include <string.h>
+#include "quadrature.h"
+
+#define LANES 0xFFFFu
+#define FLUSH_EVERY 255 // byte counters below can take this many increments
+
+// byte -> one 0/1 byte per bit, adds a 8 bit lane mask to 8 byte wide counters at once
+#define S1(v) ((uint64_t)((v) & 1) | (uint64_t)(((v) >> 1) & 1) << 8 | (uint64_t)(((v) >> 2) & 1) << 16 \
+    | (uint64_t)(((v) >> 3) & 1) << 24 | (uint64_t)(((v) >> 4) & 1) << 32 | (uint64_t)(((v) >> 5) & 1) << 40 \
+    | (uint64_t)(((v) >> 6) & 1) << 48 | (uint64_t)(((v) >> 7) & 1) << 56)
+#define S4(v) S1(v), S1((v) + 1), S1((v) + 2), S1((v) + 3)
+#define S16(v) S4(v), S4((v) + 4), S4((v) + 8), S4((v) + 12)
+#define S64(v) S16(v), S16((v) + 16), S16((v) + 32), S16((v) + 48)
+static const uint64_t SPREAD[256] = {S64(0), S64(64), S64(128), S64(192)};
+
+static uint32_t gather(const quad_decoder_t *q, uint32_t s){
+    return q->gather[0][s & 0xFF] | q->gather[1][(s >> 8) & 0xFF]
+         | q->gather[2][(s >> 16) & 0xFF] | q->gather[3][s >> 24];
+}
+
+void quad_init(quad_decoder_t *q, const uint8_t *pin_a, const uint8_t *pin_b, int n, uint32_t first){
+    memset(q, 0, sizeof(*q));
+    q->n = n > QUAD_MAX_ENCODERS ? QUAD_MAX_ENCODERS : n;
+    for (int k = 0; k < 4; k++){
+        for (int v = 0; v < 256; v++){
+            uint32_t lanes = 0;
+            for (int i = 0; i < q->n; i++){
+                if (pin_a[i] / 8 == k && (v >> (pin_a[i] % 8)) & 1) lanes |= 1u << i;
+                if (pin_b[i] / 8 == k && (v >> (pin_b[i] % 8)) & 1) lanes |= 1u << (16 + i);
+            }
+            q->gather[k][v] = lanes;
+        }
+    }
+    q->last = gather(q, first);
+}
+
+// byte i of lo is encoder i, of hi encoder 8 + i
+static void flush(quad_decoder_t *q, uint64_t fwd[2], uint64_t rev[2], uint64_t miss[2]){
+    for (int i = 0; i < q->n; i++){
+        int shift = 8 * (i % 8);
+        q->ticks[i] += (long)((fwd[i / 8] >> shift) & 0xFF) - (long)((rev[i / 8] >> shift) & 0xFF);
+        q->missed[i] += (miss[i / 8] >> shift) & 0xFF;
+    }
+    fwd[0] = fwd[1] = rev[0] = rev[1] = miss[0] = miss[1] = 0;
+}
+
+uint32_t quad_decode(quad_decoder_t *q, const uint32_t *snapshots, size_t count){
+    uint64_t fwd[2] = {0, 0}, rev[2] = {0, 0}, miss[2] = {0, 0};
+    uint32_t last = q->last, missed_mask = 0;
+    int pending = 0;
+
+    for (size_t i = 0; i < count; i++){
+        uint32_t cur = gather(q, snapshots[i]);
+        uint32_t changed = cur ^ last;
+        if (changed == 0) continue; // most snapshots when sampling faster than the edges come
+
+        uint32_t da = changed & LANES, db = changed >> 16;
+        uint32_t step = da ^ db;  // exactly one channel changed
+        uint32_t lost = da & db;  // both changed, an edge was missed
+        // forward is 00 -> 10 -> 11 -> 01, there the old A equals the new B
+        uint32_t back = step & ((last & LANES) ^ (cur >> 16));
+        uint32_t ahead = step & ~back;
+
+        fwd[0] += SPREAD[ahead & 0xFF];
+        fwd[1] += SPREAD[ahead >> 8];
+        rev[0] += SPREAD[back & 0xFF];
+        rev[1] += SPREAD[back >> 8];
+        miss[0] += SPREAD[lost & 0xFF];
+        miss[1] += SPREAD[lost >> 8];
+        missed_mask |= lost;
+        last = cur;
+
+        if (++pending == FLUSH_EVERY){
+            flush(q, fwd, rev, miss);
+            pending = 0;
+        }
+    }
+    flush(q, fwd, rev, miss);
+    q->last = last;
+    return missed_mask;
+}
@@ -0,0 +1,43 @@
+/*
+Quadrature decoding of up to 16 encoders at once from snapshots of a 32-bit GPIO bank
+(pigpio gpioRead_Bits_0_31(), the GPLEV0 register, or a recorded stream of them).
+Every snapshot is decoded for all encoders together with bitwise logic, so the cost per
+snapshot does not grow with the number of encoders the way one TRANSITION[16] lookup per
+encoder and edge does. Counts the same as encoder_transition() in tracker.h.
+Both channels changing between two snapshots means an edge was missed: no tick is
+counted(the direction is unknown) and the encoder's missed counter goes up instead.
+*/
+
+#ifndef TRACKING_QUADRATURE_H
+#define TRACKING_QUADRATURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QUAD_MAX_ENCODERS 16
+
+typedef struct {
+    int n;
+    // byte k of a snapshot -> A levels in bits 0..15 and B levels in bits 16..31, one bit per encoder
+    uint32_t gather[4][256];
+    uint32_t last; // levels of the previous snapshot in the same layout
+    long ticks[QUAD_MAX_ENCODERS];
+    unsigned long missed[QUAD_MAX_ENCODERS];
+} quad_decoder_t;
+
+// pin_a[i] and pin_b[i] are the bank bits(BCM numbers) of encoder i, first is the snapshot
+// the encoders start from
+void quad_init(quad_decoder_t *q, const uint8_t *pin_a, const uint8_t *pin_b, int n, uint32_t first);
+// decodes count snapshots in order and adds them to ticks[] and missed[],
+// returns a mask of the encoders that missed an edge in them
+uint32_t quad_decode(quad_decoder_t *q, const uint32_t *snapshots, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+/*
+Decode rate of quadrature.c against the per encoder TRANSITION lookup the ISRs do today,
+on synthetic GPIO bank snapshot streams for 1 to 16 encoders.
+Encoder i is wired to bank bits 2i(A) and 2i + 1(B). Each snapshot every encoder steps with
+the given probability, in a direction that flips now and then, and 1 in 10000 of its moves
+skips a state(both channels change) to exercise the missed edge detection.
+compile with: gcc -O2 -o quadrature_bench.exe quadrature_bench.c quadrature.c tracker.c -lm
+usage: ./quadrature_bench.exe [edge probability per snapshot, default 0.5 and 0.01]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "quadrature.h"
+#include "tracker.h"
+
+#define SNAPSHOTS (1 << 20)
+#define MIN_SECONDS 0.3
+#define SKIP_ODDS 10000
+
+static const uint8_t FORWARD[4] = {0, 2, 3, 1}; // (a << 1) | b
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t rng = 12345;
+static uint32_t next_random(void){
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// fills the stream and returns the ticks and missed edges that went into it
+static void synthesize(uint32_t *snapshots, double probability, long *ticks, unsigned long *missed){
+    int phase[QUAD_MAX_ENCODERS] = {0}, dir[QUAD_MAX_ENCODERS];
+    uint32_t threshold = (uint32_t)(probability * 4294967295.0);
+    for (int e = 0; e < QUAD_MAX_ENCODERS; e++){
+        dir[e] = 1;
+        ticks[e] = 0;
+        missed[e] = 0;
+    }
+    for (size_t i = 0; i < SNAPSHOTS; i++){
+        uint32_t s = 0;
+        for (int e = 0; e < QUAD_MAX_ENCODERS; e++){
+            if (next_random() < threshold){
+                if (next_random() % 64 == 0) dir[e] = -dir[e];
+                if (next_random() % SKIP_ODDS == 0){
+                    phase[e] = (phase[e] + 2) & 3;
+                    missed[e]++;
+                } else {
+                    phase[e] = (phase[e] + dir[e]) & 3;
+                    ticks[e] += dir[e];
+                }
+            }
+            uint8_t state = FORWARD[phase[e]];
+            s |= (uint32_t)(state >> 1) << (2 * e) | (uint32_t)(state & 1) << (2 * e + 1);
+        }
+        snapshots[i] = s;
+    }
+}
+
+// what encoderISR does, once per encoder
+static void decode_scalar(const uint32_t *snapshots, size_t count, int n, uint8_t *last,
+    long *ticks, unsigned long *missed)
+{
+    for (size_t i = 0; i < count; i++){
+        uint32_t s = snapshots[i];
+        for (int e = 0; e < n; e++){
+            int a = (s >> (2 * e)) & 1;
+            int b = (s >> (2 * e + 1)) & 1;
+            uint8_t state = (a << 1) | b;
+            int8_t delta = encoder_transition(last[e], state);
+            if (delta != 0) ticks[e] += delta;
+            else if ((state ^ last[e]) == 3) missed[e]++;
+            last[e] = state;
+        }
+    }
+}
+
+int main(int argc, char **argv){
+    double probabilities[2] = {0.5, 0.01};
+    int n_probabilities = 2;
+    if (argc > 1){
+        probabilities[0] = atof(argv[1]);
+        n_probabilities = 1;
+    }
+
+    uint32_t *snapshots = malloc(SNAPSHOTS * sizeof(uint32_t));
+    uint8_t pin_a[QUAD_MAX_ENCODERS], pin_b[QUAD_MAX_ENCODERS];
+    for (int e = 0; e < QUAD_MAX_ENCODERS; e++){
+        pin_a[e] = 2 * e;
+        pin_b[e] = 2 * e + 1;
+    }
+
+    for (int p = 0; p < n_probabilities; p++){
+        long truth_ticks[QUAD_MAX_ENCODERS];
+        unsigned long truth_missed[QUAD_MAX_ENCODERS];
+        synthesize(snapshots, probabilities[p], truth_ticks, truth_missed);
+        printf("%d snapshots, edge probability %.3g per encoder and snapshot\n", SNAPSHOTS, probabilities[p]);
+        printf("%-9s %18s %18s %9s %s\n", "encoders", "scalar [snap/s]", "parallel [snap/s]", "speedup", "check");
+
+        for (int n = 1; n <= QUAD_MAX_ENCODERS; n *= 2){
+            long ticks[QUAD_MAX_ENCODERS];
+            unsigned long missed[QUAD_MAX_ENCODERS];
+            uint8_t last[QUAD_MAX_ENCODERS];
+
+            // scalar, repeated over the stream until MIN_SECONDS
+            int runs = 0;
+            double start = now_s(), scalar;
+            do {
+                memset(ticks, 0, sizeof(ticks));
+                memset(missed, 0, sizeof(missed));
+                memset(last, 0, sizeof(last));
+                decode_scalar(snapshots, SNAPSHOTS, n, last, ticks, missed);
+                runs++;
+            } while ((scalar = now_s() - start) < MIN_SECONDS);
+            double scalar_rate = (double)runs * SNAPSHOTS / scalar;
+            int ok = 1;
+            for (int e = 0; e < n; e++) ok &= ticks[e] == truth_ticks[e] && missed[e] == truth_missed[e];
+
+            quad_decoder_t q;
+            runs = 0;
+            start = now_s();
+            double parallel;
+            do {
+                quad_init(&q, pin_a, pin_b, n, 0);
+                quad_decode(&q, snapshots, SNAPSHOTS);
+                runs++;
+            } while ((parallel = now_s() - start) < MIN_SECONDS);
+            double parallel_rate = (double)runs * SNAPSHOTS / parallel;
+            for (int e = 0; e < n; e++) ok &= q.ticks[e] == truth_ticks[e] && q.missed[e] == truth_missed[e];
+
+            printf("%-9d %18.3e %18.3e %8.1fx %s\n", n, scalar_rate, parallel_rate,
+                parallel_rate / scalar_rate, ok ? "ok" : "MISMATCH");
+        }
+        printf("\n");
+    }
+    free(snapshots);
+    return 0;
+}
@@ -0,0 +1,314 @@
+/*
+compile with: gcc -O3 -fno-math-errno -fno-trapping-math -fopenmp-simd -c solar.c
+Algorithm from Meeus, Astronomical Algorithms ch. 12, 22, 25 and 40.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "solar.h"
+
+#define PI 3.14159265358979323846
+#define DEG (PI / 180.0)
+#define ARCSEC (DEG / 3600.0)
+#define UNIX_JD 2440587.5 // julian day of 1970-01-01T00:00:00
+#define J2000_JD 2451545.0
+#define BATCH_CHUNK 256
+#define CROSSING_STEP 600.0 // altitude scan step [s], shorter than any day or night
+#define CROSSING_SPAN (2 * 86400.0)
+
+// Earth shape, same radii as pck00011.tpc [km]
+#define EARTH_EQUATORIAL 6378.1366
+#define EARTH_POLAR 6356.7519
+
+const observer_t SOLAR_SITE = {0.790213649, 0.239491811, 0.2235};
+
+// Polynomial coefficients in T, julian centuries TT since J2000, constant term first.
+
+// geometric mean longitude of the sun [deg]
+static const double SUN_MEAN_LONGITUDE[3] = {280.46646, 36000.76983, 0.0003032};
+// mean anomaly of the sun [deg]
+static const double SUN_MEAN_ANOMALY[3] = {357.52911, 35999.05029, -0.0001537};
+// eccentricity of Earth's orbit
+static const double EARTH_ECCENTRICITY[3] = {0.016708634, -0.000042037, -0.0000001267};
+// equation of center, coefficients of sin(M), sin(2M), sin(3M) [deg]
+static const double SUN_CENTER[3][3] = {
+    {1.914602, -0.004817, -0.000014},
+    {0.019993, -0.000101, 0.0},
+    {0.000289, 0.0, 0.0}
+};
+// mean longitude of the moon [deg]
+static const double MOON_MEAN_LONGITUDE[2] = {218.3165, 481267.8813};
+// longitude of the ascending node of the moon's orbit [deg]
+static const double MOON_NODE[3] = {125.04452, -1934.136261, 0.0020708};
+// mean obliquity of the ecliptic [arcsec]
+static const double OBLIQUITY[4] = {84381.448, -46.8150, -0.00059, 0.001813};
+// Greenwich mean sidereal time, first two terms are per day of UT since J2000 [deg]
+static const double GMST[4] = {280.46061837, 360.98564736629, 0.000387933, -1.0 / 38710000.0};
+
+// nutation: multipliers of (sun mean longitude, moon mean longitude, node), dpsi sin and deps cos [arcsec]
+static const double NUTATION[4][5] = {
+    {0, 0, 1, -17.20,  9.20},
+    {2, 0, 0,  -1.32,  0.57},
+    {0, 2, 0,  -0.23,  0.10},
+    {0, 0, 2,   0.21, -0.09}
+};
+
+#define ABERRATION (20.4898 * ARCSEC) // times 1/R[AU]
+#define SUN_PARALLAX (8.794 * ARCSEC) // times 1/R[AU]
+
+static inline double poly2(const double c[2], double t){ return c[0] + t * c[1]; }
+static inline double poly3(const double c[3], double t){ return c[0] + t * (c[1] + t * c[2]); }
+static inline double poly4(const double c[4], double t){ return c[0] + t * (c[1] + t * (c[2] + t * c[3])); }
+
+// floor() through an int conversion, libm floor does not vectorise on plain x86-64(no SSE4.1).
+// Arguments here stay far below 2^31.
+static inline double fast_floor(double x){
+    double t = (double)(int)x;
+    return t - (double)(t > x);
+}
+
+static inline double wrap_2pi(double a){
+    return a - 2*PI * fast_floor(a / (2*PI));
+}
+
+static inline double wrap_pi(double a){
+    return a - 2*PI * fast_floor((a + PI) / (2*PI));
+}
+
+/*
+Branch free sin/cos/atan2/asin for the kernel. libm calls stop GCC from vectorising the loop
+(sin+cos of the same angle get merged into sincos, and libmvec only exists on x86),
+these are plain arithmetic and vectorise on NEON as well. Error is below 1e-12 rad.
+The selects only become vector blends with -fno-trapping-math, see the compile line.
+*/
+
+// pi/2 split in three parts for an exact range reduction
+#define PIO2_1 1.57079632673412561417e+00
+#define PIO2_2 6.07710050650619224932e-11
+#define PIO2_3 2.02226624879595063154e-21
+
+static inline void fast_sincos(double x, double *sin_out, double *cos_out){
+    double k = fast_floor(x * (2.0 / PI) + 0.5);
+    double r = ((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3;
+    int q = (int)k & 3; // quadrant, two's complement makes this right for negative k too
+
+    // Taylor series on [-pi/4, pi/4]
+    double r2 = r * r;
+    double s = r * (1 + r2 * (-1.0/6 + r2 * (1.0/120 + r2 * (-1.0/5040 + r2 * (1.0/362880
+             + r2 * (-1.0/39916800 + r2 * (1.0/6227020800 + r2 * (-1.0/1307674368000))))))));
+    double c = 1 + r2 * (-1.0/2 + r2 * (1.0/24 + r2 * (-1.0/720 + r2 * (1.0/40320
+             + r2 * (-1.0/3628800 + r2 * (1.0/479001600 + r2 * (-1.0/87178291200
+             + r2 * (1.0/20922789888000))))))));
+
+    double sn = (q & 1) ? c : s;
+    double cs = (q & 1) ? s : c;
+    *sin_out = (q & 2) ? -sn : sn;
+    *cos_out = ((q + 1) & 2) ? -cs : cs;
+}
+
+static inline double fast_sin(double x){
+    double s, c;
+    fast_sincos(x, &s, &c);
+    return s;
+}
+
+static inline double fast_cos(double x){
+    double s, c;
+    fast_sincos(x, &s, &c);
+    return c;
+}
+
+static inline double fast_atan2(double y, double x){
+    double ax = fabs(x), ay = fabs(y);
+    double hi = (ax > ay) ? ax : ay;
+    double lo = (ax > ay) ? ay : ax;
+    double t = lo / ((hi > 1e-300) ? hi : 1e-300); // 0..1
+
+    // atan(t) = 2 atan(t / (1 + sqrt(1 + t^2))), twice brings t below tan(pi/16)
+    t = t / (1 + sqrt(1 + t*t));
+    t = t / (1 + sqrt(1 + t*t));
+    double t2 = t * t;
+    double a = 4 * t * (1 + t2 * (-1.0/3 + t2 * (1.0/5 + t2 * (-1.0/7 + t2 * (1.0/9
+             + t2 * (-1.0/11 + t2 * (1.0/13 + t2 * (-1.0/15 + t2 * (1.0/17 + t2 * (-1.0/19))))))))));
+
+    a = (ay > ax) ? PI/2 - a : a;
+    a = (x < 0) ? PI - a : a;
+    return copysign(a, y);
+}
+
+static inline double fast_asin(double x){
+    double c2 = 1 - x*x;
+    return fast_atan2(x, sqrt((c2 > 0) ? c2 : 0));
+}
+
+// written out per term instead of looping, an inner loop keeps the batch loop from vectorising
+static inline void nutation_term(int i, double l0, double lm, double node, double *dpsi, double *deps){
+    double arg = NUTATION[i][0] * l0 + NUTATION[i][1] * lm + NUTATION[i][2] * node;
+    double sin_arg, cos_arg;
+    fast_sincos(arg, &sin_arg, &cos_arg);
+    *dpsi += NUTATION[i][3] * sin_arg;
+    *deps += NUTATION[i][4] * cos_arg;
+}
+
+// nutation in longitude and true obliquity [rad]
+static inline void nutation(double t, double l0, double *dpsi_out, double *eps_out){
+    double lm = poly2(MOON_MEAN_LONGITUDE, t) * DEG;
+    double node = poly3(MOON_NODE, t) * DEG;
+    double dpsi = 0, deps = 0;
+    nutation_term(0, l0, lm, node, &dpsi, &deps);
+    nutation_term(1, l0, lm, node, &dpsi, &deps);
+    nutation_term(2, l0, lm, node, &dpsi, &deps);
+    nutation_term(3, l0, lm, node, &dpsi, &deps);
+    *dpsi_out = dpsi * ARCSEC;
+    *eps_out = poly4(OBLIQUITY, t) * ARCSEC + deps * ARCSEC;
+}
+
+// apparent local sidereal time, not wrapped [rad]
+static inline double apparent_sidereal(double d_ut, double t, double dpsi, double cos_eps, double lon){
+    double gmst = (GMST[0] + GMST[1] * d_ut) * DEG + (GMST[2] * t*t + GMST[3] * t*t*t) * DEG;
+    return gmst + dpsi * cos_eps + lon;
+}
+
+// The whole computation for one timestamp. No branches and no table lookups that
+// depend on the data, so a loop over it vectorises.
+static inline __attribute__((always_inline)) void solar_kernel(double unix_time, double lon,
+    double sin_lat, double cos_lat, double rho_sin, double rho_cos,
+    double *ra_out, double *dec_out, double *ha_out, double *alt_out, double *az_out, double *r_out)
+{
+    double d_ut = (unix_time / 86400.0 + UNIX_JD) - J2000_JD;
+    double t = (d_ut + SOLAR_TT_MINUS_UTC / 86400.0) / 36525.0;
+
+    // sun's geometric longitude and distance
+    double l0 = poly3(SUN_MEAN_LONGITUDE, t) * DEG;
+    double m = poly3(SUN_MEAN_ANOMALY, t) * DEG;
+    double e = poly3(EARTH_ECCENTRICITY, t);
+    double c = (poly3(SUN_CENTER[0], t) * fast_sin(m)
+              + poly3(SUN_CENTER[1], t) * fast_sin(2*m)
+              + poly3(SUN_CENTER[2], t) * fast_sin(3*m)) * DEG;
+    double true_long = l0 + c;
+    double nu = m + c;
+    double r = 1.000001018 * (1 - e*e) / (1 + e * fast_cos(nu));
+
+    double dpsi, eps;
+    nutation(t, l0, &dpsi, &eps);
+
+    // apparent geocentric RA/Dec
+    double lambda = true_long + dpsi - ABERRATION / r;
+    double sin_lambda, cos_lambda, sin_eps, cos_eps;
+    fast_sincos(lambda, &sin_lambda, &cos_lambda);
+    fast_sincos(eps, &sin_eps, &cos_eps);
+    double ra = fast_atan2(cos_eps * sin_lambda, cos_lambda);
+    double sin_dec = sin_eps * sin_lambda;
+    double cos_dec = sqrt(1 - sin_dec * sin_dec);
+
+    // geocentric hour angle
+    double ha = wrap_pi(apparent_sidereal(d_ut, t, dpsi, cos_eps, lon) - ra);
+
+    // topocentric correction for the observer's position on the ellipsoid
+    double sin_par = SUN_PARALLAX / r; // below 9 arcsec, sin(x) == x
+    double sin_ha, cos_ha;
+    fast_sincos(ha, &sin_ha, &cos_ha);
+    double dra = fast_atan2(-rho_cos * sin_par * sin_ha, cos_dec - rho_cos * sin_par * cos_ha);
+    double dec_topo = fast_atan2((sin_dec - rho_sin * sin_par) * fast_cos(dra), cos_dec - rho_cos * sin_par * cos_ha);
+    double ha_topo = ha - dra;
+
+    // horizon coordinates, east/north/up components of the unit vector to the sun
+    double sin_ht, cos_ht, sin_dt, cos_dt;
+    fast_sincos(ha_topo, &sin_ht, &cos_ht);
+    fast_sincos(dec_topo, &sin_dt, &cos_dt);
+    double east = -cos_dt * sin_ht;
+    double north = sin_dt * cos_lat - cos_dt * cos_ht * sin_lat;
+    double up = sin_dt * sin_lat + cos_dt * cos_ht * cos_lat;
+
+    *ra_out = wrap_2pi(ra + dra);
+    *dec_out = dec_topo;
+    *ha_out = wrap_pi(ha_topo);
+    *alt_out = fast_asin(up);
+    *az_out = wrap_2pi(fast_atan2(east, north));
+    *r_out = r;
+}
+
+// geocentric position of the observer, rho*sin(phi') and rho*cos(phi') in earth radii
+static void observer_terms(const observer_t *obs, double *rho_sin, double *rho_cos){
+    double ratio = EARTH_POLAR / EARTH_EQUATORIAL;
+    double u = atan(ratio * tan(obs->lat));
+    *rho_sin = ratio * sin(u) + obs->alt / EARTH_EQUATORIAL * sin(obs->lat);
+    *rho_cos = cos(u) + obs->alt / EARTH_EQUATORIAL * cos(obs->lat);
+}
+
+void solar_position(double unix_time, const observer_t *obs, solar_position_t *out){
+    double rho_sin, rho_cos;
+    observer_terms(obs, &rho_sin, &rho_cos);
+    solar_kernel(unix_time, obs->lon, sin(obs->lat), cos(obs->lat), rho_sin, rho_cos,
+        &out->ra, &out->dec, &out->ha, &out->alt, &out->az, &out->distance);
+}
+
+double solar_ha(double unix_time, const observer_t *obs){
+    solar_position_t pos;
+    solar_position(unix_time, obs, &pos);
+    return pos.ha;
+}
+
+double solar_sidereal_time(double unix_time, double lon){
+    double d_ut = (unix_time / 86400.0 + UNIX_JD) - J2000_JD;
+    double t = (d_ut + SOLAR_TT_MINUS_UTC / 86400.0) / 36525.0;
+    double dpsi, eps;
+    nutation(t, poly3(SUN_MEAN_LONGITUDE, t) * DEG, &dpsi, &eps);
+    return wrap_2pi(apparent_sidereal(d_ut, t, dpsi, cos(eps), lon));
+}
+
+static double solar_alt(double unix_time, const observer_t *obs){
+    solar_position_t pos;
+    solar_position(unix_time, obs, &pos);
+    return pos.alt;
+}
+
+double solar_next_crossing(double unix_time, const observer_t *obs, double altitude, int rising){
+    double t0 = unix_time;
+    int above0 = solar_alt(t0, obs) >= altitude;
+    for (double t1 = t0 + CROSSING_STEP; t1 <= unix_time + CROSSING_SPAN; t0 = t1, t1 += CROSSING_STEP){
+        int above1 = solar_alt(t1, obs) >= altitude;
+        if (above0 == above1 || above1 != (rising != 0)){
+            above0 = above1;
+            continue;
+        }
+        // bisect the step down to ~1 ms
+        for (int i = 0; i < 20; i++){
+            double mid = 0.5 * (t0 + t1);
+            if ((solar_alt(mid, obs) >= altitude) == above1) t1 = mid;
+            else t0 = mid;
+        }
+        return t1;
+    }
+    return NAN;
+}
+
+void solar_position_batch(const double *unix_time, size_t n, const observer_t *obs,
+    double *ra, double *dec, double *ha, double *alt, double *az)
+{
+    double rho_sin, rho_cos;
+    observer_terms(obs, &rho_sin, &rho_cos);
+    double lon = obs->lon;
+    double sin_lat = sin(obs->lat), cos_lat = cos(obs->lat);
+
+    // results go through fixed size scratch arrays so the hot loop never checks for NULL outputs
+    double c_ra[BATCH_CHUNK], c_dec[BATCH_CHUNK], c_ha[BATCH_CHUNK];
+    double c_alt[BATCH_CHUNK], c_az[BATCH_CHUNK], c_r[BATCH_CHUNK];
+
+    for (size_t base = 0; base < n; base += BATCH_CHUNK){
+        size_t len = (n - base < BATCH_CHUNK) ? n - base : BATCH_CHUNK;
+        const double *times = unix_time + base;
+
+        #pragma omp simd
+        for (size_t i = 0; i < len; i++){
+            solar_kernel(times[i], lon, sin_lat, cos_lat, rho_sin, rho_cos,
+                &c_ra[i], &c_dec[i], &c_ha[i], &c_alt[i], &c_az[i], &c_r[i]);
+        }
+
+        if (ra) memcpy(ra + base, c_ra, len * sizeof(double));
+        if (dec) memcpy(dec + base, c_dec, len * sizeof(double));
+        if (ha) memcpy(ha + base, c_ha, len * sizeof(double));
+        if (alt) memcpy(alt + base, c_alt, len * sizeof(double));
+        if (az) memcpy(az + base, c_az, len * sizeof(double));
+    }
+}
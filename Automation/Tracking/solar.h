@@ -0,0 +1,63 @@
+/*
+Analytic sun position, no CSPICE and no kernel files needed.
+Low precision Meeus/NOAA algorithm(mean elements + equation of center, 4 term nutation,
+aberration and topocentric parallax), good to a few tens of arcseconds in the years around J2000.
+RA/Dec are apparent, referred to the true equator and equinox of date.
+*/
+
+#ifndef TRACKING_SOLAR_H
+#define TRACKING_SOLAR_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// TT - UTC = 32.184 s + TAI-UTC(37 s since 2017). UT1 - UTC (<0.9 s) is ignored.
+#define SOLAR_TT_MINUS_UTC 69.184
+// unix time of J2000(2000-01-01T12:00:00 TT) counted with the current leap second offset,
+// so et = unix - SOLAR_UNIX_J2000 is the ephemeris time SPICE would give for the same UTC
+#define SOLAR_UNIX_J2000 (946728000.0 - SOLAR_TT_MINUS_UTC)
+
+typedef struct {
+    double lat; // geodetic latitude [rad]
+    double lon; // east longitude [rad]
+    double alt; // height above the ellipsoid [km]
+} observer_t;
+
+typedef struct {
+    double ra;  // topocentric right ascension [rad, 0..2pi]
+    double dec; // topocentric declination [rad]
+    double ha;  // topocentric hour angle [rad, -pi..pi]
+    double alt; // geometric altitude, no refraction [rad]
+    double az;  // azimuth from north through east [rad, 0..2pi]
+    double distance; // sun - earth distance [AU]
+} solar_position_t;
+
+// Callisto antenna site, same numbers the SPICE ephemeris uses
+extern const observer_t SOLAR_SITE;
+
+void solar_position(double unix_time, const observer_t *obs, solar_position_t *out);
+
+// Evaluates n timestamps at once. Any output array may be NULL if not needed.
+// Written as a branch free structure-of-arrays loop so the compiler vectorises it,
+// build with -O3 -fno-math-errno -fno-trapping-math -fopenmp-simd or it stays scalar.
+void solar_position_batch(const double *unix_time, size_t n, const observer_t *obs,
+    double *ra, double *dec, double *ha, double *alt, double *az);
+
+double solar_ha(double unix_time, const observer_t *obs);
+// apparent local sidereal time at east longitude lon [rad, 0..2pi]
+double solar_sidereal_time(double unix_time, double lon);
+
+// altitude of the sun's center at sunrise/sunset: 34' refraction + 16' semi-diameter below the horizon
+#define SOLAR_HORIZON (-0.833 * 3.14159265358979323846 / 180.0)
+// first time after unix_time that the sun rises(rising = 1) or sets(rising = 0) through altitude [rad],
+// to about a millisecond. NAN if that does not happen within two days(polar day or night).
+double solar_next_crossing(double unix_time, const observer_t *obs, double altitude, int rising);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
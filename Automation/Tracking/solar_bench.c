@@ -0,0 +1,129 @@
+/*
+Throughput of the analytic sun position engine(scalar and batch) against the SPICE getHa(),
+and how far the analytic hour angle is from SPICE over several years.
+compile with: gcc -O3 -fno-math-errno -fno-trapping-math -fopenmp-simd -o solar_bench.exe solar_bench.c solar.c ephemeris.c clock.c -I/path/to/cspice/include -L/path/to/cspice/lib -lm -lcspice -lpthread
+usage: ./solar_bench.exe [first year] [last year]
+The default range ends at 2025 because earth_000101_260327_251229.bpc stops in March 2026.
+The SPICE comparison has not been run yet(no CSPICE build or kernels at hand). Against astropy
+(ERFA sun, IERS UT1, TETE frame) at SOLAR_SITE, 3 hourly over 2020-2025: HA max 35.8" rms 12.8",
+declination max 12.5" rms 3.8".
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include "SpiceUsr.h"
+#include "solar.h"
+#include "ephemeris.h"
+
+#define PI 3.14159265358979323846
+#define RAD_TO_ARCSEC (180.0 / PI * 3600.0)
+#define BENCH_N 200000
+#define BENCH_SPICE_N 20000
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static SpiceDouble et_from_unix(time_t t){
+    SpiceDouble et;
+    char utc_str[80];
+    struct tm utc;
+    gmtime_r(&t, &utc);
+    strftime(utc_str, sizeof(utc_str), "%Y-%m-%dT%H:%M:%S", &utc);
+    str2et_c(utc_str, &et);
+    return et;
+}
+
+static time_t year_start(int year){
+    struct tm tm = {0};
+    tm.tm_year = year - 1900;
+    tm.tm_mday = 1;
+    return timegm(&tm);
+}
+
+static void throughput(void){
+    double *times = malloc(BENCH_N * sizeof(double));
+    double *ha = malloc(BENCH_N * sizeof(double));
+    double *alt = malloc(BENCH_N * sizeof(double));
+    double *az = malloc(BENCH_N * sizeof(double));
+    double t0 = (double)year_start(2025);
+    for (int i = 0; i < BENCH_N; i++) times[i] = t0 + i * 157.0; // about a year
+
+    volatile double sink = 0;
+    double start = now_s();
+    for (int i = 0; i < BENCH_N; i++){
+        solar_position_t pos;
+        solar_position(times[i], &SOLAR_SITE, &pos);
+        sink += pos.ha;
+    }
+    double scalar = now_s() - start;
+
+    start = now_s();
+    solar_position_batch(times, BENCH_N, &SOLAR_SITE, NULL, NULL, ha, alt, az);
+    double batch = now_s() - start;
+
+    double max_diff = 0;
+    for (int i = 0; i < BENCH_N; i++){
+        solar_position_t pos;
+        solar_position(times[i], &SOLAR_SITE, &pos);
+        if (fabs(pos.ha - ha[i]) > max_diff) max_diff = fabs(pos.ha - ha[i]);
+    }
+
+    start = now_s();
+    for (int i = 0; i < BENCH_SPICE_N; i++){
+        sink += getHaAt(et_from_unix((time_t)times[i]));
+    }
+    double spice = now_s() - start;
+
+    printf("Throughput\n");
+    printf("SPICE getHa()     %12.0f evaluations/s   %8.3f us each\n", BENCH_SPICE_N / spice, spice / BENCH_SPICE_N * 1e6);
+    printf("solar_position()  %12.0f evaluations/s   %8.3f us each\n", BENCH_N / scalar, scalar / BENCH_N * 1e6);
+    printf("batch             %12.0f evaluations/s   %8.3f us each   (%.1fx scalar)\n", BENCH_N / batch, batch / BENCH_N * 1e6, scalar / batch);
+    printf("batch vs scalar max difference %.3g arcsec\n\n", max_diff * RAD_TO_ARCSEC);
+
+    free(times);
+    free(ha);
+    free(alt);
+    free(az);
+}
+
+static void deviation(int first_year, int last_year){
+    printf("Hour angle, analytic - SPICE getHa(), hourly samples\n");
+    printf("year        samples    mean[\"]     rms[\"]     max[\"]\n");
+
+    long all_n = 0;
+    double all_sum_sq = 0, all_max = 0;
+    for (int year = first_year; year <= last_year; year++){
+        long n = 0;
+        double sum = 0, sum_sq = 0, max_abs = 0;
+        for (time_t t = year_start(year); t < year_start(year + 1); t += 3600){
+            double d = solar_ha((double)t, &SOLAR_SITE) - getHaAt(et_from_unix(t));
+            d = remainder(d, 2*PI) * RAD_TO_ARCSEC;
+            n++;
+            sum += d;
+            sum_sq += d * d;
+            if (fabs(d) > max_abs) max_abs = fabs(d);
+        }
+        printf("%d %12ld %10.2f %10.2f %10.2f\n", year, n, sum / n, sqrt(sum_sq / n), max_abs);
+        all_n += n;
+        all_sum_sq += sum_sq;
+        if (max_abs > all_max) all_max = max_abs;
+    }
+    printf("all  %12ld %10s %10.2f %10.2f\n", all_n, "", sqrt(all_sum_sq / all_n), all_max);
+}
+
+int main(int argc, char **argv){
+    int first_year = 2020, last_year = 2025;
+    if (argc > 1) first_year = atoi(argv[1]);
+    if (argc > 2) last_year = atoi(argv[2]);
+
+    ephemeris_init();
+    throughput();
+    deviation(first_year, last_year);
+    ephemeris_close();
+    return 0;
+}
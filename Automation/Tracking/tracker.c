@@ -0,0 +1,125 @@
+/*
+compile with: gcc -c tracker.c
+*/
+
+#include <math.h>
+#include "tracker.h"
+
+void pid_init(pid_state_t *pid, float Kp, float Ki, float Kd){
+    pid->Kp = Kp;
+    pid->Ki = Ki;
+    pid->Kd = Kd;
+    pid->integral = 0;
+    pid->prev_error = 0;
+}
+
+float pid_step(pid_state_t *pid, float error, float dt){
+    pid->integral += error * dt;
+    if (pid->integral > 1000) pid->integral = 1000; // anti-windup
+    if (pid->integral < -1000) pid->integral = -1000;
+
+    float derivative = (error - pid->prev_error) / dt;
+    float output = pid->Kp * error + pid->Ki * pid->integral + pid->Kd * derivative;
+
+    pid->prev_error = error;
+    return output;
+}
+
+int8_t encoder_transition(uint8_t last_state, uint8_t state){
+    // 0 is invalid state or no move, +1 and -1 are step increments
+    static const int8_t TRANSITION[16] = {
+    0, -1, 1, 0,
+	1, 0, 0, -1,
+	-1, 0, 0, 1,
+	0, 1, -1, 0
+    };
+    uint8_t index = ((last_state & 3) << 2) | (state & 3);
+    return TRANSITION[index];
+}
+
+long wrap_ticks(long ticks){
+    if (ticks > TICKS_PER_REV/2) {
+        ticks -= TICKS_PER_REV;
+    } else if (ticks < -TICKS_PER_REV/2) {
+        ticks += TICKS_PER_REV;
+    }
+    return ticks;
+}
+
+float wrap_error(float error){
+    error = fmodf(error, TICKS_PER_REV);
+    if (error > TICKS_PER_REV/2) error -= TICKS_PER_REV;
+    else if (error < -TICKS_PER_REV/2) error += TICKS_PER_REV;
+    return error;
+}
+
+float ha_to_ticks(double ha){
+    float ticks = (float)(ha/(2*PI) * TICKS_PER_REV + TICKS_PER_REV/4.0f);
+    if (ticks > TICKS_PER_REV/2){
+        ticks -= TICKS_PER_REV;
+    } else if (ticks < -TICKS_PER_REV/2){
+        ticks += TICKS_PER_REV;
+    }
+    return ticks;
+}
+
+long ha_to_setpoint(double ha){
+    return wrap_ticks((long)ha_to_ticks(ha));
+}
+
+int step_half_period_us(float step_rate){
+    float abs_rate = fabsf(step_rate);
+    if (abs_rate < 1.0f) return 0; // idle if rate too low
+
+    int delay_us = (int)(1000000.0 / (abs_rate * 2.0)); // two edges per step
+    if (delay_us < STEP_MIN_HALF_PERIOD_US) delay_us = STEP_MIN_HALF_PERIOD_US;
+    return delay_us;
+}
+
+void encoder_init(encoder_t *enc, uint8_t state){
+    enc->ticks = 0;
+    enc->last_state = state;
+    enc->missed_edges = 0;
+}
+
+int8_t encoder_update(encoder_t *enc, uint8_t state){
+    int8_t delta = encoder_transition(enc->last_state, state);
+    if (delta != 0) enc->ticks = wrap_ticks(enc->ticks + delta);
+    else if ((state ^ enc->last_state) == 3) enc->missed_edges++;
+    enc->last_state = state;
+    return delta;
+}
+
+void guidance_init(guidance_t *g, float Kp, float Ki, float Kd){
+    pid_init(&g->pid, Kp, Ki, Kd);
+    g->setpoint = 0;
+    g->cycles = TARGET_POSITION_UPDATE_MULTIPLIER + 1;
+    g->error = 0;
+}
+
+int guidance_refresh_due(guidance_t *g){
+    if (g->cycles > TARGET_POSITION_UPDATE_MULTIPLIER){
+        g->cycles = 1;
+        return 1;
+    }
+    g->cycles++;
+    return 0;
+}
+
+float guidance_control(guidance_t *g, long encoder_ticks, float dt){
+    // go the short way around when setpoint and encoder are on opposite sides of the wrap
+    g->error = wrap_error((float)(g->setpoint - encoder_ticks));
+    return pid_step(&g->pid, g->error, dt);
+}
+
+int stepper_edge(stepper_t *s, float step_rate){
+    if (s->high){
+        s->high = 0;
+        return s->half_period_us;
+    }
+    s->half_period_us = step_half_period_us(step_rate);
+    if (s->half_period_us == 0) return 0;
+    s->forward = step_rate >= 0;
+    s->high = 1;
+    return s->half_period_us;
+}
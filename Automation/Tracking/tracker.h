@@ -0,0 +1,89 @@
+/*
+Control core of the solar tracker: encoder decoding, setpoint math, PID and step timing.
+No GPIO and no threads in here, so main.c and the simulator run the exact same code.
+*/
+
+#ifndef TRACKING_TRACKER_H
+#define TRACKING_TRACKER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// encoder ticks per revolution of output shaft(encoder ticks * gearbox ratio)
+#define TICKS_PER_REV 5000.0f
+#define PID_PERIOD 1.0f // ms
+#define PI 3.14159265358979323846
+#define TARGET_POSITION_UPDATE_MULTIPLIER 5000
+
+#define STEP_MIN_HALF_PERIOD_US 50 // speed limit
+#define STEP_IDLE_US 1000          // poll period of the stepper thread when not stepping
+
+typedef struct {
+    float Kp, Ki, Kd;
+    float integral;
+    float prev_error;
+} pid_state_t;
+
+void pid_init(pid_state_t *pid, float Kp, float Ki, float Kd);
+// returns the commanded step rate in steps/sec
+float pid_step(pid_state_t *pid, float error, float dt);
+
+// quadrature decoding, state is (a << 1) | b
+int8_t encoder_transition(uint8_t last_state, uint8_t state);
+// keeps a tick count inside [-TICKS_PER_REV/2, TICKS_PER_REV/2]
+long wrap_ticks(long ticks);
+// shortest signed distance between two positions on the circle, in ticks
+float wrap_error(float error);
+
+// hour angle [rad] to output shaft position, 0 ticks is the sun at -90 deg HA(6h before transit)
+float ha_to_ticks(double ha);
+long ha_to_setpoint(double ha);
+
+// half period of the step signal for the given rate, 0 when the rate is too low to step
+int step_half_period_us(float step_rate);
+
+// --- Loop bodies of the encoder ISR, guidance and stepper threads ---
+// main.c, station.cpp and tracking_sim.c only add GPIO, locking and sleeping around these.
+
+typedef struct {
+    long ticks;
+    uint8_t last_state;
+    long missed_edges; // both channels changed, direction unknown
+} encoder_t;
+
+void encoder_init(encoder_t *enc, uint8_t state);
+// feeds the current (a << 1) | b state, returns the tick delta
+int8_t encoder_update(encoder_t *enc, uint8_t state);
+
+typedef struct {
+    pid_state_t pid;
+    long setpoint;
+    uint32_t cycles; // since the last setpoint refresh
+    float error;     // of the last cycle [ticks]
+} guidance_t;
+
+void guidance_init(guidance_t *g, float Kp, float Ki, float Kd);
+// call once per PID_PERIOD of the fixed rate loop, true every TARGET_POSITION_UPDATE_MULTIPLIER
+// cycles(and on the first one): then the caller refreshes g->setpoint from the ephemeris
+int guidance_refresh_due(guidance_t *g);
+// PID on the short way from encoder_ticks to g->setpoint, returns the step rate [steps/sec]
+float guidance_control(guidance_t *g, long encoder_ticks, float dt);
+
+typedef struct {
+    int high;    // step pin level
+    int forward; // direction pin level
+    int half_period_us;
+} stepper_t;
+
+// advances the step signal by one edge and returns the time until the next one [us], 0 when the
+// rate is too low to step(the pin stays low). The rate and direction are taken on rising edges.
+int stepper_edge(stepper_t *s, float step_rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
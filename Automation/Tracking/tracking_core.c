@@ -0,0 +1,124 @@
+/*
+compile with: gcc -O3 -fno-math-errno -fno-trapping-math -fopenmp-simd -fPIC -fvisibility=hidden -shared
+                  -Wl,-soname,libtrackingcore.so.1 -o libtrackingcore.so.1 tracking_core.c solar.c tracker.c -lm
+              ln -sf libtrackingcore.so.1 libtrackingcore.so
+*/
+
+#include <math.h>
+#include "tracking_core.h"
+#include "tracker.h"
+
+static const observer_t *site(const observer_t *obs){
+    return obs ? obs : &SOLAR_SITE;
+}
+
+static double wrap_2pi(double a){
+    a = fmod(a, 2*PI);
+    return a < 0 ? a + 2*PI : a;
+}
+
+static double wrap_pi(double a){
+    a = wrap_2pi(a);
+    return a > PI ? a - 2*PI : a;
+}
+
+int tc_abi_version(void){
+    return TC_ABI_VERSION;
+}
+
+void tc_site(observer_t *out){
+    *out = SOLAR_SITE;
+}
+
+void tc_sun_position(double unix_time, const observer_t *obs, solar_position_t *out){
+    solar_position(unix_time, site(obs), out);
+}
+
+double tc_sun_ha(double unix_time, const observer_t *obs){
+    return solar_ha(unix_time, site(obs));
+}
+
+double tc_sun_next_crossing(double unix_time, const observer_t *obs, int rising){
+    return solar_next_crossing(unix_time, site(obs), SOLAR_HORIZON, rising);
+}
+
+double tc_sidereal_time(double unix_time, double lon){
+    return solar_sidereal_time(unix_time, lon);
+}
+
+double tc_ha_from_ra(double lst, double ra){
+    return wrap_pi(lst - ra);
+}
+
+double tc_ra_from_ha(double lst, double ha){
+    return wrap_2pi(lst - ha);
+}
+
+// spherical triangle pole - zenith - object, Meeus ch. 13
+static void horizontal_to_equatorial(double lst, double sin_lat, double cos_lat, double alt, double az,
+    double *ra, double *dec, double *ha)
+{
+    double sin_alt = sin(alt), cos_alt = cos(alt);
+    double sin_az = sin(az), cos_az = cos(az);
+    double h = atan2(-sin_az * cos_alt, sin_alt * cos_lat - cos_alt * sin_lat * cos_az);
+    if (ra) *ra = wrap_2pi(lst - h);
+    if (dec) *dec = asin(sin_alt * sin_lat + cos_alt * cos_lat * cos_az);
+    if (ha) *ha = h;
+}
+
+void tc_horizontal_to_equatorial(double unix_time, const observer_t *obs, double alt, double az,
+    double *ra, double *dec, double *ha)
+{
+    obs = site(obs);
+    horizontal_to_equatorial(solar_sidereal_time(unix_time, obs->lon), sin(obs->lat), cos(obs->lat),
+        alt, az, ra, dec, ha);
+}
+
+double tc_ha_to_ticks(double ha){
+    return ha_to_ticks(ha);
+}
+
+int64_t tc_ha_to_setpoint(double ha){
+    return ha_to_setpoint(ha);
+}
+
+double tc_ticks_to_ha(double ticks){
+    return wrap_pi((ticks - TICKS_PER_REV/4.0) / TICKS_PER_REV * 2*PI);
+}
+
+double tc_wrap_error(double error){
+    return wrap_error((float)error);
+}
+
+int tc_encoder_transition(int last_state, int state){
+    return encoder_transition((uint8_t)last_state, (uint8_t)state);
+}
+
+int tc_step_half_period_us(double step_rate){
+    return step_half_period_us((float)step_rate);
+}
+
+void tc_sun_position_batch(const double *unix_time, size_t n, const observer_t *obs,
+    double *ra, double *dec, double *ha, double *alt, double *az)
+{
+    solar_position_batch(unix_time, n, site(obs), ra, dec, ha, alt, az);
+}
+
+void tc_sidereal_time_batch(const double *unix_time, size_t n, double lon, double *lst){
+    for (size_t i = 0; i < n; i++) lst[i] = solar_sidereal_time(unix_time[i], lon);
+}
+
+void tc_horizontal_to_equatorial_batch(const double *unix_time, const double *alt, const double *az,
+    size_t n, const observer_t *obs, double *ra, double *dec, double *ha)
+{
+    obs = site(obs);
+    double sin_lat = sin(obs->lat), cos_lat = cos(obs->lat);
+    for (size_t i = 0; i < n; i++){
+        horizontal_to_equatorial(solar_sidereal_time(unix_time[i], obs->lon), sin_lat, cos_lat, alt[i], az[i],
+            ra ? &ra[i] : NULL, dec ? &dec[i] : NULL, ha ? &ha[i] : NULL);
+    }
+}
+
+void tc_ha_to_setpoint_batch(const double *ha, size_t n, int64_t *setpoint){
+    for (size_t i = 0; i < n; i++) setpoint[i] = ha_to_setpoint(ha[i]);
+}
@@ -0,0 +1,74 @@
+/*
+The tracking core(analytic ephemeris, sidereal time, HA/RA and alt/az conversion, encoder and
+step math) as a shared library, libtrackingcore.so, for the Python tooling(see trackingcore.py).
+Only the tc_ functions are exported. This is a stable ABI: existing functions never change
+their signature or meaning, new ones are only added, and TC_ABI_VERSION together with the
+soname goes up if that ever has to be broken.
+Units are the ones the C code uses: radians, unix time in seconds(UTC), km for heights.
+observer_t and solar_position_t from solar.h are part of the ABI; obs == NULL means the
+Callisto antenna site(SOLAR_SITE).
+*/
+
+#ifndef TRACKING_CORE_H
+#define TRACKING_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "solar.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TC_ABI_VERSION 1
+
+#if defined(__GNUC__)
+#define TC_API __attribute__((visibility("default")))
+#else
+#define TC_API
+#endif
+
+TC_API int tc_abi_version(void);
+TC_API void tc_site(observer_t *out);
+
+// --- ephemeris ---
+TC_API void tc_sun_position(double unix_time, const observer_t *obs, solar_position_t *out);
+TC_API double tc_sun_ha(double unix_time, const observer_t *obs);
+// next sunrise(rising = 1) or sunset(rising = 0) after unix_time, NAN if none within two days
+TC_API double tc_sun_next_crossing(double unix_time, const observer_t *obs, int rising);
+TC_API double tc_sidereal_time(double unix_time, double lon);
+
+// --- coordinates ---
+TC_API double tc_ha_from_ra(double lst, double ra); // -pi..pi
+TC_API double tc_ra_from_ha(double lst, double ha); // 0..2pi
+// alt/az(az from north through east, no refraction) to RA/Dec of date and hour angle,
+// what routines.convertToEquatorial did through astropy. Any output may be NULL.
+TC_API void tc_horizontal_to_equatorial(double unix_time, const observer_t *obs, double alt, double az,
+    double *ra, double *dec, double *ha);
+
+// --- encoder and stepper ---
+TC_API double tc_ha_to_ticks(double ha);
+TC_API int64_t tc_ha_to_setpoint(double ha);
+// inverse of tc_ha_to_ticks
+TC_API double tc_ticks_to_ha(double ticks);
+TC_API double tc_wrap_error(double error);
+TC_API int tc_encoder_transition(int last_state, int state);
+TC_API int tc_step_half_period_us(double step_rate);
+
+/*
+Batch variants work on caller owned arrays of n elements, nothing is allocated or copied, so
+numpy arrays(C contiguous float64/int64) can be passed straight in. Outputs may be NULL
+if not needed.
+*/
+TC_API void tc_sun_position_batch(const double *unix_time, size_t n, const observer_t *obs,
+    double *ra, double *dec, double *ha, double *alt, double *az);
+TC_API void tc_sidereal_time_batch(const double *unix_time, size_t n, double lon, double *lst);
+TC_API void tc_horizontal_to_equatorial_batch(const double *unix_time, const double *alt, const double *az,
+    size_t n, const observer_t *obs, double *ra, double *dec, double *ha);
+TC_API void tc_ha_to_setpoint_batch(const double *ha, size_t n, int64_t *setpoint);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,291 @@
+/*
+Runs the tracker control loop against the motor/encoder model on a simulated clock.
+A full day of tracking takes seconds and gives the same result every run.
+compile with: gcc -O2 -fopenmp-simd -o tracking_sim.exe tracking_sim.c clock.c tracker.c ephemeris.c motor_model.c solar.c adaptive.c -I/path/to/cspice/include -L/path/to/cspice/lib -lm -lcspice -lpthread
+or without CSPICE: gcc -O2 -fopenmp-simd -DEPHEMERIS_ANALYTIC -o tracking_sim.exe tracking_sim.c clock.c tracker.c ephemeris.c motor_model.c solar.c adaptive.c -lm -lpthread
+usage: ./tracking_sim.exe [start date YYYY-MM-DD] [hours] [encoder ticks per motor step] [fixed|adaptive] [gust ticks]
+fixed is the 1 kHz loop of main.c, adaptive the event driven one(see adaptive.h). A gust pushes the
+shaft by the given ticks halfway through the run.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "clock.h"
+#include "tracker.h"
+#include "ephemeris.h"
+#include "motor_model.h"
+#include "solar.h"
+#include "adaptive.h"
+
+#define ACQUIRED_TICKS 2.0 // tracking counts as acquired once the error drops below this
+#define SAMPLE_NS (10 * 1000000ULL) // pointing error sample period, independent of the control rate
+
+typedef struct {
+    long count;
+    double sum;
+    double sum_sq;
+    double max_abs;
+    uint64_t max_at_ns;
+} error_stats_t;
+
+// encoderISR's state plus what only the simulation counts
+typedef struct {
+    encoder_t enc;
+    long wraps;
+    int event; // an edge came in since the guidance loop last looked
+} sim_encoder_t;
+
+static void stats_add(error_stats_t *s, double err, uint64_t now_ns){
+    s->count++;
+    s->sum += err;
+    s->sum_sq += err * err;
+    if (fabs(err) > s->max_abs){
+        s->max_abs = fabs(err);
+        s->max_at_ns = now_ns;
+    }
+}
+
+static void stats_print(const char *name, const error_stats_t *s){
+    if (s->count == 0){
+        printf("%-10s no samples\n", name);
+        return;
+    }
+    double deg = 360.0 / TICKS_PER_REV;
+    double mean = s->sum / s->count;
+    double rms = sqrt(s->sum_sq / s->count);
+    time_t max_at = (time_t)(s->max_at_ns / NS_PER_SEC);
+    char max_str[32];
+    strftime(max_str, sizeof(max_str), "%H:%M:%S", gmtime(&max_at));
+    printf("%-10s mean %8.3f ticks (%7.4f deg)   rms %8.3f ticks (%7.4f deg)   max %8.3f ticks (%7.4f deg) at %s UTC\n",
+        name, mean, mean * deg, rms, rms * deg, s->max_abs, s->max_abs * deg, max_str);
+}
+
+// what encoderISR in main.c does
+static void encoder_edge(uint8_t state, void *ctx){
+    sim_encoder_t *sim = ctx;
+    long before = sim->enc.ticks;
+    encoder_update(&sim->enc, state);
+    if (labs(sim->enc.ticks - before) > 1) sim->wraps++;
+    sim->event = 1;
+}
+
+static time_t parse_date(const char *str){
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(str, "%d-%d-%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday) != 3){
+        fprintf(stderr, "bad date '%s', expected YYYY-MM-DD\n", str);
+        exit(1);
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return timegm(&tm);
+}
+
+static void usage(const char *name){
+    fprintf(stderr, "usage: %s [start date YYYY-MM-DD] [hours] [encoder ticks per motor step] [fixed|adaptive] [gust ticks]\n", name);
+    exit(1);
+}
+
+// NAN unless the whole string is a finite number
+static double parse_number(const char *str){
+    char *end;
+    double value = strtod(str, &end);
+    if (end == str || *end != '\0' || !isfinite(value)) return NAN;
+    return value;
+}
+
+static double sim_ha_at(double unix_time, void *ctx){
+    (void)ctx;
+    return getHaAt(ephemerisTimeFromUnix(unix_time));
+}
+
+int main(int argc, char **argv){
+    time_t start = time(NULL);
+    start -= start % 86400; // today 00:00 UTC
+    double hours = 24.0;
+    double ticks_per_step = 1.0;
+    int adaptive_rate = 0;
+    double gust_ticks = 0;
+    if (argc > 6) usage(argv[0]);
+    if (argc > 1) start = parse_date(argv[1]);
+    if (argc > 2) hours = parse_number(argv[2]);
+    if (argc > 3) ticks_per_step = parse_number(argv[3]);
+    if (argc > 4){
+        if (strcmp(argv[4], "adaptive") == 0) adaptive_rate = 1;
+        else if (strcmp(argv[4], "fixed") != 0) usage(argv[0]);
+    }
+    if (argc > 5) gust_ticks = parse_number(argv[5]);
+    if (!(hours > 0) || !(ticks_per_step > 0) || isnan(gust_ticks)) usage(argv[0]);
+
+    ephemeris_init();
+    clock_init_simulated(start);
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    motor_model_t motor;
+    motor_model_init(&motor, ticks_per_step, 0.0); // starts homed
+    sim_encoder_t enc = {.wraps = 0, .event = 0};
+    encoder_init(&enc.enc, motor_model_encoder_state(&motor));
+    adaptive_t adaptive;
+    adaptive_init(&adaptive, &SOLAR_SITE, sim_ha_at, NULL);
+
+    uint64_t t = clock_now_ns();
+    uint64_t end = t + (uint64_t)(hours * 3600.0 * NS_PER_SEC);
+    uint64_t period_ns = 1000000 * PID_PERIOD;
+    uint64_t update_ns = period_ns * TARGET_POSITION_UPDATE_MULTIPLIER;
+    uint64_t gust_at = gust_ticks != 0 ? t + (end - t) / 2 : UINT64_MAX;
+
+    // guidance thread state
+    uint64_t next_control = t;
+    guidance_t guidance;
+    guidance_init(&guidance, 10.0, 0.0, 0.0);
+    float target_step_rate = 0;
+    long control_cycles = 0;
+    long ephemeris_calls = 0;
+
+    // stepper thread state
+    uint64_t next_step = t;
+    stepper_t stepper = {0, 0, 0};
+    long stepper_wakeups = 0;
+    long daylight_wakeups = 0; // guidance and stepper while the sun is up
+    uint64_t daylight_ns = 0;
+
+    // true sun position, linearly interpolated between two ephemeris samples
+    uint64_t next_sample = t;
+    uint64_t truth_t0 = 0;
+    double truth_ha0 = 0, truth_dha = 0;
+    int sun_up = 0;
+
+    error_stats_t total = {0}, acquired = {0}, daylight = {0}, hourly[24];
+    memset(hourly, 0, sizeof(hourly));
+    uint64_t acquired_at = 0;
+
+    while (t < end){
+        if (next_sample <= next_control && next_sample <= next_step){
+            t = next_sample;
+            clock_set_ns(t);
+
+            if (t >= truth_t0 + update_ns || truth_t0 == 0){
+                double unix_time = t / (double)NS_PER_SEC;
+                double ha = getHaAt(ephemerisTimeFromUnix(unix_time));
+                double ha_next = getHaAt(ephemerisTimeFromUnix(unix_time + update_ns / (double)NS_PER_SEC));
+                truth_t0 = t;
+                truth_ha0 = ha;
+                truth_dha = remainder(ha_next - ha, 2*PI);
+                // daylight only when the sun is up for the whole interval
+                solar_position_t pos, pos_next;
+                solar_position(unix_time, &SOLAR_SITE, &pos);
+                solar_position(unix_time + update_ns / (double)NS_PER_SEC, &SOLAR_SITE, &pos_next);
+                sun_up = pos.alt >= SOLAR_HORIZON && pos_next.alt >= SOLAR_HORIZON;
+            }
+
+            double frac = (double)(t - truth_t0) / update_ns;
+            double truth = ha_to_ticks(truth_ha0 + truth_dha * frac);
+            double pointing = wrap_error((float)(truth - enc.enc.ticks));
+            stats_add(&total, pointing, t);
+            if (!acquired_at && fabs(pointing) < ACQUIRED_TICKS) acquired_at = t;
+            if (acquired_at){
+                stats_add(&acquired, pointing, t);
+            }
+            if (sun_up) daylight_ns += SAMPLE_NS;
+            if (acquired_at && sun_up){
+                stats_add(&daylight, pointing, t);
+                stats_add(&hourly[(t / NS_PER_SEC) % 86400 / 3600], pointing, t);
+            }
+            next_sample += SAMPLE_NS;
+        } else if (next_control <= next_step){
+            t = next_control;
+            clock_set_ns(t);
+
+            if (t >= gust_at){
+                motor_model_push(&motor, gust_ticks, encoder_edge, &enc);
+                gust_at = UINT64_MAX;
+            }
+
+            // adaptiveGuidanceThread / guidanceThread
+            if (adaptive_rate){
+                double next = adaptive_update(&adaptive, t / (double)NS_PER_SEC, enc.enc.ticks);
+                guidance.setpoint = adaptive.setpoint;
+                next_control = (uint64_t)(next * NS_PER_SEC);
+                if (next_control <= t) next_control = t + 1; // double has ~250 ns resolution here
+                if (gust_at < next_control) next_control = gust_at;
+            } else {
+                if (guidance_refresh_due(&guidance)){
+                    guidance.setpoint = ha_to_setpoint(getHaAt(getEphemerisTime()));
+                    ephemeris_calls++;
+                }
+                next_control += period_ns;
+            }
+            target_step_rate = guidance_control(&guidance, enc.enc.ticks, PID_PERIOD / 1000.0);
+            // an idle stepper thread waits for the guidance thread in adaptive mode
+            if (adaptive_rate && next_step == UINT64_MAX && step_half_period_us(target_step_rate) != 0) next_step = t;
+
+            control_cycles++;
+            daylight_wakeups += sun_up;
+        } else {
+            t = next_step;
+            clock_set_ns(t);
+            stepper_wakeups++;
+            daylight_wakeups += sun_up;
+
+            // stepperThread
+            int delay_us = stepper_edge(&stepper, target_step_rate);
+            if (delay_us == 0){
+                // idle if rate too low
+                next_step = adaptive_rate ? UINT64_MAX : next_step + (uint64_t)STEP_IDLE_US * NS_PER_US;
+                continue;
+            }
+            if (stepper.high){
+                motor_model_set_dir(&motor, stepper.forward);
+                motor_model_step(&motor, encoder_edge, &enc);
+            }
+            next_step += (uint64_t)delay_us * NS_PER_US;
+        }
+        // encoder edges wake the guidance thread in adaptive mode
+        if (adaptive_rate && enc.event){
+            enc.event = 0;
+            if (next_control > t) next_control = t;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    double simulated = hours * 3600.0;
+
+    char start_str[32];
+    strftime(start_str, sizeof(start_str), "%Y-%m-%d %H:%M:%S", gmtime(&start));
+    if (adaptive_rate) ephemeris_calls = adaptive.ephemeris_calls;
+    printf("Simulated %.1f h of %s rate tracking from %s UTC in %.2f s (%.0fx real time)\n",
+        hours, adaptive_rate ? "adaptive" : "fixed", start_str, wall, simulated / wall);
+    printf("control cycles: %ld;   ephemeris calls: %ld;   motor steps: %ld;   encoder wraps: %ld;   missed edges: %ld\n",
+        control_cycles, ephemeris_calls, motor.steps, enc.wraps, enc.enc.missed_edges);
+    // adaptive parks at night, so only the daylight figures compare the two modes while tracking
+    printf("wakeups: guidance %ld + stepper %ld = %.1f per second over the whole run, %.1f per second in daylight\n",
+        control_cycles, stepper_wakeups, (control_cycles + stepper_wakeups) / simulated,
+        daylight_ns ? daylight_wakeups / (daylight_ns / (double)NS_PER_SEC) : 0.0);
+    if (acquired_at){
+        printf("acquired sun after %.3f s\n", (acquired_at - start * NS_PER_SEC) / (double)NS_PER_SEC);
+    } else {
+        printf("never acquired sun\n");
+    }
+
+    printf("\nPointing error (sun position - encoder), total and acquired cover the whole run including the night:\n");
+    stats_print("total", &total);
+    stats_print("acquired", &acquired);
+    stats_print("daylight", &daylight);
+    printf("\nPer UTC hour while tracking in daylight:\n");
+    for (int h = 0; h < 24; h++){
+        if (hourly[h].count == 0) continue;
+        char name[16];
+        snprintf(name, sizeof(name), "%02d:00", h);
+        stats_print(name, &hourly[h]);
+    }
+
+    ephemeris_close();
+    return 0;
+}
@@ -0,0 +1,216 @@
+'''
+Python bindings for libtrackingcore.so (tracking_core.h), so the Python tooling can use the
+native ephemeris and tracking math instead of astropy/PyEphem.
+Build the library first (compile line in tracking_core.c). It is looked up in
+$TRACKING_CORE_LIB, next to this file, then on the normal library path.
+
+Angles are radians and times unix seconds, like the C code. The *_batch functions take
+numpy float64 arrays (or array.array('d')) and hand their memory to C without copying.
+'''
+
+import array
+import ctypes
+import math
+import os
+import time
+from collections import namedtuple
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+ABI_VERSION = 1
+
+c_double_p = ctypes.POINTER(ctypes.c_double)
+c_int64_p = ctypes.POINTER(ctypes.c_int64)
+
+
+class Observer(ctypes.Structure):
+    '''observer_t: geodetic latitude and east longitude [rad], height [km]'''
+    _fields_ = [('lat', ctypes.c_double), ('lon', ctypes.c_double), ('alt', ctypes.c_double)]
+
+    @classmethod
+    def from_degrees(cls, lat, lon, height_m):
+        '''same units as LAT, LON and ALTITUDE in old/constants.py'''
+        return cls(math.radians(lat), math.radians(lon), height_m / 1000.0)
+
+
+class _SolarPosition(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_double) for name in ('ra', 'dec', 'ha', 'alt', 'az', 'distance')]
+
+
+SunPosition = namedtuple('SunPosition', 'ra dec ha alt az distance')
+Equatorial = namedtuple('Equatorial', 'ra dec ha')
+
+
+def _load():
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates = [os.environ.get('TRACKING_CORE_LIB'),
+                  os.path.join(here, 'libtrackingcore.so.1'),
+                  os.path.join(here, 'libtrackingcore.so'),
+                  'libtrackingcore.so.1']
+    for path in candidates:
+        if not path:
+            continue
+        try:
+            return ctypes.CDLL(path)
+        except OSError:
+            pass
+    raise OSError('libtrackingcore.so not found, build it or set TRACKING_CORE_LIB')
+
+
+_lib = _load()
+
+_SIGNATURES = {
+    'tc_abi_version': (ctypes.c_int, []),
+    'tc_site': (None, [ctypes.POINTER(Observer)]),
+    'tc_sun_position': (None, [ctypes.c_double, ctypes.POINTER(Observer), ctypes.POINTER(_SolarPosition)]),
+    'tc_sun_ha': (ctypes.c_double, [ctypes.c_double, ctypes.POINTER(Observer)]),
+    'tc_sun_next_crossing': (ctypes.c_double, [ctypes.c_double, ctypes.POINTER(Observer), ctypes.c_int]),
+    'tc_sidereal_time': (ctypes.c_double, [ctypes.c_double, ctypes.c_double]),
+    'tc_ha_from_ra': (ctypes.c_double, [ctypes.c_double, ctypes.c_double]),
+    'tc_ra_from_ha': (ctypes.c_double, [ctypes.c_double, ctypes.c_double]),
+    'tc_horizontal_to_equatorial': (None, [ctypes.c_double, ctypes.POINTER(Observer), ctypes.c_double,
+                                           ctypes.c_double, c_double_p, c_double_p, c_double_p]),
+    'tc_ha_to_ticks': (ctypes.c_double, [ctypes.c_double]),
+    'tc_ha_to_setpoint': (ctypes.c_int64, [ctypes.c_double]),
+    'tc_ticks_to_ha': (ctypes.c_double, [ctypes.c_double]),
+    'tc_wrap_error': (ctypes.c_double, [ctypes.c_double]),
+    'tc_encoder_transition': (ctypes.c_int, [ctypes.c_int, ctypes.c_int]),
+    'tc_step_half_period_us': (ctypes.c_int, [ctypes.c_double]),
+    'tc_sun_position_batch': (None, [c_double_p, ctypes.c_size_t, ctypes.POINTER(Observer),
+                                     c_double_p, c_double_p, c_double_p, c_double_p, c_double_p]),
+    'tc_sidereal_time_batch': (None, [c_double_p, ctypes.c_size_t, ctypes.c_double, c_double_p]),
+    'tc_horizontal_to_equatorial_batch': (None, [c_double_p, c_double_p, c_double_p, ctypes.c_size_t,
+                                                 ctypes.POINTER(Observer), c_double_p, c_double_p, c_double_p]),
+    'tc_ha_to_setpoint_batch': (None, [c_double_p, ctypes.c_size_t, c_int64_p]),
+}
+
+for _name, (_restype, _argtypes) in _SIGNATURES.items():
+    _function = getattr(_lib, _name)
+    _function.restype = _restype
+    _function.argtypes = _argtypes
+
+if _lib.tc_abi_version() != ABI_VERSION:
+    raise ImportError('libtrackingcore ABI %d, bindings are for %d' % (_lib.tc_abi_version(), ABI_VERSION))
+
+# the Callisto antenna site, the default observer everywhere
+SITE = Observer()
+_lib.tc_site(ctypes.byref(SITE))
+
+
+def _now(t):
+    return time.time() if t is None else t
+
+
+def _ref(obs):
+    return None if obs is None else ctypes.byref(obs)
+
+
+# --- scalar ---
+
+def sun_position(t=None, obs=None):
+    '''topocentric apparent sun position, replaces sun.compute(observer)'''
+    out = _SolarPosition()
+    _lib.tc_sun_position(_now(t), _ref(obs), ctypes.byref(out))
+    return SunPosition(out.ra, out.dec, out.ha, out.alt, out.az, out.distance)
+
+
+def sun_ha(t=None, obs=None):
+    return _lib.tc_sun_ha(_now(t), _ref(obs))
+
+
+def next_sunrise(t=None, obs=None):
+    return _lib.tc_sun_next_crossing(_now(t), _ref(obs), 1)
+
+
+def next_sunset(t=None, obs=None):
+    return _lib.tc_sun_next_crossing(_now(t), _ref(obs), 0)
+
+
+def sidereal_time(t=None, lon=None):
+    '''apparent local sidereal time, replaces Time.sidereal_time('apparent', loc)'''
+    return _lib.tc_sidereal_time(_now(t), SITE.lon if lon is None else lon)
+
+
+def ha_from_ra(lst, ra):
+    return _lib.tc_ha_from_ra(lst, ra)
+
+
+def ra_from_ha(lst, ha):
+    return _lib.tc_ra_from_ha(lst, ha)
+
+
+def horizontal_to_equatorial(alt, az, t=None, obs=None):
+    '''RA/Dec of date and hour angle of an alt/az pointing, replaces routines.convertToEquatorial'''
+    ra, dec, ha = ctypes.c_double(), ctypes.c_double(), ctypes.c_double()
+    _lib.tc_horizontal_to_equatorial(_now(t), _ref(obs), alt, az,
+                                     ctypes.byref(ra), ctypes.byref(dec), ctypes.byref(ha))
+    return Equatorial(ra.value, dec.value, ha.value)
+
+
+ha_to_ticks = _lib.tc_ha_to_ticks
+ha_to_setpoint = _lib.tc_ha_to_setpoint
+ticks_to_ha = _lib.tc_ticks_to_ha
+wrap_error = _lib.tc_wrap_error
+encoder_transition = _lib.tc_encoder_transition
+step_half_period_us = _lib.tc_step_half_period_us
+
+
+# --- batch ---
+
+def _input(values):
+    '''(object that owns the memory, pointer to it, length). Copies only if values is not
+    already a contiguous float64 array. Only 1-D input, ravel() anything else first.'''
+    if np is not None and not isinstance(values, array.array):
+        owner = np.ascontiguousarray(values, dtype=np.float64)
+        if owner.ndim != 1:
+            raise ValueError('batch input has to be 1-D, got shape %s' % (owner.shape,))
+        return owner, owner.ctypes.data_as(c_double_p), owner.size
+    if not (isinstance(values, array.array) and values.typecode == 'd'):
+        values = array.array('d', values)
+    address, length = values.buffer_info()
+    return values, ctypes.cast(address, c_double_p), length
+
+
+def _output(n, typecode='d'):
+    pointer_type = c_double_p if typecode == 'd' else c_int64_p
+    if np is not None:
+        out = np.empty(n, dtype=np.float64 if typecode == 'd' else np.int64)
+        return out, out.ctypes.data_as(pointer_type)
+    out = array.array(typecode, bytes(8 * n))
+    return out, ctypes.cast(out.buffer_info()[0], pointer_type)
+
+
+def sun_position_batch(times, obs=None):
+    '''SunPosition of arrays(distance is None) for every unix time in times'''
+    owner, pointer, n = _input(times)
+    outputs = [_output(n) for _ in range(5)]
+    _lib.tc_sun_position_batch(pointer, n, _ref(obs), *[p for _, p in outputs])
+    return SunPosition(*[o for o, _ in outputs], None)
+
+
+def sidereal_time_batch(times, lon=None):
+    owner, pointer, n = _input(times)
+    lst, lst_p = _output(n)
+    _lib.tc_sidereal_time_batch(pointer, n, SITE.lon if lon is None else lon, lst_p)
+    return lst
+
+
+def horizontal_to_equatorial_batch(times, alt, az, obs=None):
+    t_owner, t_p, n = _input(times)
+    alt_owner, alt_p, n_alt = _input(alt)
+    az_owner, az_p, n_az = _input(az)
+    if not n == n_alt == n_az:
+        raise ValueError('times, alt and az have different lengths')
+    outputs = [_output(n) for _ in range(3)]
+    _lib.tc_horizontal_to_equatorial_batch(t_p, alt_p, az_p, n, _ref(obs), *[p for _, p in outputs])
+    return Equatorial(*[o for o, _ in outputs])
+
+
+def ha_to_setpoint_batch(ha):
+    owner, pointer, n = _input(ha)
+    out, out_p = _output(n, 'q')
+    _lib.tc_ha_to_setpoint_batch(pointer, n, out_p)
+    return out
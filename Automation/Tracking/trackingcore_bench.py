@@ -0,0 +1,145 @@
+'''
+Time per call of libtrackingcore against the astropy/PyEphem calls it replaces in old/master.py
+and old/routines.py, and how far apart their answers are. astropy, PyEphem and numpy are
+optional, whatever is not installed is skipped.
+usage: python3 trackingcore_bench.py [batch size]
+'''
+
+import array
+import math
+import sys
+import time
+from datetime import datetime, timezone
+
+import trackingcore as tc
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+try:
+    import astropy.units as u
+    from astropy.coordinates import SkyCoord, EarthLocation, AltAz, Angle, get_body
+    from astropy.time import Time
+except ImportError:
+    Time = None
+try:
+    import ephem
+except ImportError:
+    ephem = None
+
+# old/constants.py
+LAT = 45.276055
+LON = 13.721878
+ALTITUDE = 226
+
+MIN_SECONDS = 0.5
+
+
+def per_call(function, calls_per_run=1):
+    '''seconds per call, repeated for at least MIN_SECONDS'''
+    function()
+    runs = 0
+    start = time.perf_counter()
+    while True:
+        function()
+        runs += 1
+        elapsed = time.perf_counter() - start
+        if elapsed >= MIN_SECONDS:
+            return elapsed / (runs * calls_per_run)
+
+
+def row(name, seconds, baseline=None):
+    speedup = '' if baseline is None else '%10.0fx' % (seconds / baseline)
+    print('%-52s %12.3f %s' % (name, seconds * 1e6, speedup))
+
+
+def degrees(rad):
+    return rad * 180 / math.pi
+
+
+def main():
+    n = int(sys.argv[1]) if len(sys.argv) > 1 else 100000
+    obs = tc.Observer.from_degrees(LAT, LON, ALTITUDE)
+    now = time.time()
+    times = [now + 60.0 * i for i in range(n)]
+    times = np.array(times) if np is not None else array.array('d', times)
+    alt = [math.radians(30)] * n
+    az = [math.radians(180)] * n
+    if np is not None:
+        alt, az = np.array(alt), np.array(az)
+    else:
+        alt, az = array.array('d', alt), array.array('d', az)
+
+    print('numpy %s, astropy %s, PyEphem %s, batch of %d' % (
+        'yes' if np is not None else 'no (array.array)', 'yes' if Time else 'no', 'yes' if ephem else 'no', n))
+    print('%-52s %12s %11s' % ('call', 'us/call', 'vs native'))
+
+    native = {
+        'sun': per_call(lambda: tc.sun_position(now, obs)),
+        'lst': per_call(lambda: tc.sidereal_time(now, obs.lon)),
+        'equatorial': per_call(lambda: tc.horizontal_to_equatorial(math.radians(30), math.radians(180), now, obs)),
+    }
+    row('native sun_position', native['sun'])
+    row('native sidereal_time', native['lst'])
+    row('native horizontal_to_equatorial', native['equatorial'])
+    row('native ha_to_setpoint', per_call(lambda: tc.ha_to_setpoint(0.1)))
+    row('native sun_position_batch, per element', per_call(lambda: tc.sun_position_batch(times, obs), n))
+    native['lst_batch'] = per_call(lambda: tc.sidereal_time_batch(times, obs.lon), n)
+    row('native sidereal_time_batch, per element', native['lst_batch'])
+    row('native horizontal_to_equatorial_batch, per element',
+        per_call(lambda: tc.horizontal_to_equatorial_batch(times, alt, az, obs), n))
+
+    if ephem is not None:
+        observer = ephem.Observer()
+        observer.lon = str(LON)
+        observer.lat = str(LAT)
+        observer.elevation = ALTITUDE
+        sun = ephem.Sun(observer)
+
+        def pyephem_sun():
+            observer.date = datetime.now(timezone.utc)
+            sun.compute(observer)
+        row('PyEphem observer.date = now; sun.compute(observer)', per_call(pyephem_sun), native['sun'])
+        row('PyEphem observer.sidereal_time()', per_call(lambda: observer.sidereal_time()), native['lst'])
+
+        observer.date = datetime.fromtimestamp(now, timezone.utc)
+        sun.compute(observer)
+        pos = tc.sun_position(now, obs)
+        print('  vs PyEphem: sun RA %.1f", Dec %.1f", LST %.2f s' % (
+            degrees(pos.ra - sun.ra) * 3600, degrees(pos.dec - sun.dec) * 3600,
+            degrees(tc.sidereal_time(now, obs.lon) - observer.sidereal_time()) * 240))
+
+    if Time is not None:
+        loc = EarthLocation(lat=LAT * u.deg, lon=LON * u.deg, height=ALTITUDE * u.m)
+
+        def astropy_lst():
+            Angle(Time(datetime.now(timezone.utc), scale='utc').sidereal_time('apparent', loc)).degree
+
+        def convert_to_equatorial():
+            home = AltAz(alt=Angle(30, unit=u.deg), az=Angle(180, unit=u.deg))
+            coords = SkyCoord(alt=home.alt, az=home.az, obstime=datetime.now(timezone.utc), frame='altaz', location=loc)
+            coords.transform_to('icrs')
+
+        def astropy_sun():
+            t = Time(datetime.now(timezone.utc), scale='utc')
+            get_body('sun', t, loc).transform_to(AltAz(obstime=t, location=loc))
+
+        row('astropy get_body(sun).transform_to(AltAz)', per_call(astropy_sun), native['sun'])
+        row("astropy Time.sidereal_time('apparent', loc)", per_call(astropy_lst), native['lst'])
+        row('astropy routines.convertToEquatorial', per_call(convert_to_equatorial), native['equatorial'])
+        if np is not None:
+            row("astropy Time(array).sidereal_time, per element",
+                per_call(lambda: Time(times, format='unix').sidereal_time('apparent', loc), n), native['lst_batch'])
+
+        t = Time(now, format='unix')
+        lst = t.sidereal_time('apparent', loc).radian
+        sun = get_body('sun', t, loc).transform_to(AltAz(obstime=t, location=loc))
+        pos = tc.sun_position(now, obs)
+        print('  vs astropy: sun alt %.1f", az %.1f", LST %.3f s' % (
+            (degrees(pos.alt) - sun.alt.deg) * 3600, (degrees(pos.az) - sun.az.deg) * 3600,
+            degrees(tc.sidereal_time(now, obs.lon) - lst) * 240))
+
+
+if __name__ == '__main__':
+    main()
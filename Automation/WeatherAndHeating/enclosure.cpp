@@ -0,0 +1,188 @@
+/*
+compile with: g++ -std=c++20 -O2 -c enclosure.cpp
+BME280 compensation is the floating point version from the Bosch datasheet, section 8.1.
+*/
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "enclosure.hpp"
+
+I2cBus::I2cBus(const char *path){
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), path);
+}
+
+I2cBus::~I2cBus(){
+    close(fd);
+}
+
+// register address write and read in one transfer, so several devices can share the fd
+bool I2cBus::read(uint8_t address, uint8_t reg, uint8_t *buf, uint16_t len){
+    i2c_msg msgs[2] = {
+        {address, 0, 1, &reg},
+        {address, I2C_M_RD, len, buf},
+    };
+    i2c_rdwr_ioctl_data data = {msgs, 2};
+    return ioctl(fd, I2C_RDWR, &data) == 2;
+}
+
+bool I2cBus::write(uint8_t address, uint8_t reg, uint8_t value){
+    uint8_t buf[2] = {reg, value};
+    i2c_msg msg = {address, 0, 2, buf};
+    i2c_rdwr_ioctl_data data = {&msg, 1};
+    return ioctl(fd, I2C_RDWR, &data) == 1;
+}
+
+bool I2cBus::write16(uint8_t address, uint8_t reg, uint16_t value){
+    uint8_t buf[3] = {reg, (uint8_t)(value >> 8), (uint8_t)value};
+    i2c_msg msg = {address, 0, 3, buf};
+    i2c_rdwr_ioctl_data data = {&msg, 1};
+    return ioctl(fd, I2C_RDWR, &data) == 1;
+}
+
+static uint16_t le16(const uint8_t *p){ return (uint16_t)(p[0] | (p[1] << 8)); }
+
+Bme280::Bme280(I2cBus &bus, uint8_t address) : bus(bus), address(address){
+    uint8_t c[26], h[7];
+    if (!bus.read(address, 0x88, c, sizeof(c)) || !bus.read(address, 0xE1, h, sizeof(h))){
+        throw std::system_error(EIO, std::generic_category(), "BME280 calibration");
+    }
+    T1 = le16(c + 0);
+    T2 = (int16_t)le16(c + 2);
+    T3 = (int16_t)le16(c + 4);
+    P1 = le16(c + 6);
+    P2 = (int16_t)le16(c + 8);
+    P3 = (int16_t)le16(c + 10);
+    P4 = (int16_t)le16(c + 12);
+    P5 = (int16_t)le16(c + 14);
+    P6 = (int16_t)le16(c + 16);
+    P7 = (int16_t)le16(c + 18);
+    P8 = (int16_t)le16(c + 20);
+    P9 = (int16_t)le16(c + 22);
+    H1 = c[25];
+    H2 = (int16_t)le16(h + 0);
+    H3 = h[2];
+    H4 = (int16_t)((int8_t)h[3] * 16 | (h[4] & 0x0F));
+    H5 = (int16_t)((int8_t)h[5] * 16 | (h[4] >> 4));
+    H6 = (int8_t)h[6];
+}
+
+bool Bme280::start(){
+    // humidity, then temperature and pressure oversampling x1 and forced mode
+    return bus.write(address, 0xF2, 0x01) && bus.write(address, 0xF4, 0x25);
+}
+
+bool Bme280::read(EnvSample &out){
+    uint8_t d[8];
+    if (!bus.read(address, 0xF7, d, sizeof(d))) return false;
+    int32_t adc_P = (d[0] << 12) | (d[1] << 4) | (d[2] >> 4);
+    int32_t adc_T = (d[3] << 12) | (d[4] << 4) | (d[5] >> 4);
+    int32_t adc_H = (d[6] << 8) | d[7];
+
+    double var1 = (adc_T / 16384.0 - T1 / 1024.0) * T2;
+    double var2 = (adc_T / 131072.0 - T1 / 8192.0) * (adc_T / 131072.0 - T1 / 8192.0) * T3;
+    double t_fine = var1 + var2;
+    out.temperature = t_fine / 5120.0;
+
+    var1 = t_fine / 2.0 - 64000.0;
+    var2 = var1 * var1 * P6 / 32768.0;
+    var2 = var2 + var1 * P5 * 2.0;
+    var2 = var2 / 4.0 + P4 * 65536.0;
+    var1 = (P3 * var1 * var1 / 524288.0 + P2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * P1;
+    if (var1 == 0.0){
+        out.pressure = 0;
+    } else {
+        double p = 1048576.0 - adc_P;
+        p = (p - var2 / 4096.0) * 6250.0 / var1;
+        var1 = P9 * p * p / 2147483648.0;
+        var2 = p * P8 / 32768.0;
+        out.pressure = (p + (var1 + var2 + P7) / 16.0) / 100.0;
+    }
+
+    double h = t_fine - 76800.0;
+    h = (adc_H - (H4 * 64.0 + H5 / 16384.0 * h)) * (H2 / 65536.0 * (1.0 + H6 / 67108864.0 * h * (1.0 + H3 / 67108864.0 * h)));
+    h = h * (1.0 - H1 * h / 524288.0);
+    out.humidity = h > 100.0 ? 100.0 : h < 0.0 ? 0.0 : h;
+    return true;
+}
+
+Ina219::Ina219(I2cBus &bus, uint8_t address, double max_expected_amps, int range, int gain, int bus_adc, int shunt_adc)
+    : bus(bus), address(address)
+{
+    const double GAIN_VOLTS[4] = {0.04, 0.08, 0.16, 0.32};
+    if (gain == INA_GAIN_AUTO){
+        gain = INA_GAIN_8_320MV;
+        for (int g = INA_GAIN_8_320MV; g >= INA_GAIN_1_40MV; g--){
+            if (max_expected_amps * SHUNT_OHMS <= GAIN_VOLTS[g]) gain = g;
+        }
+    }
+    // current LSB spreads the expected current over the 15 bit register, calibration from datasheet section 8.5.1
+    double max_possible_amps = GAIN_VOLTS[gain] / SHUNT_OHMS;
+    double current_lsb = (max_expected_amps < max_possible_amps ? max_expected_amps : max_possible_amps) / 32767;
+    double min_lsb = 0.04096 / (SHUNT_OHMS * 0xFFFE);
+    if (current_lsb < min_lsb) current_lsb = min_lsb;
+    uint16_t calibration = (uint16_t)std::trunc(0.04096 / (current_lsb * SHUNT_OHMS));
+    uint16_t config = (uint16_t)(range << 13 | gain << 11 | bus_adc << 7 | shunt_adc << 3 | 0x7); // continuous shunt and bus
+
+    if (!bus.write16(address, 0x05, calibration) || !bus.write16(address, 0x00, config)){
+        throw std::system_error(EIO, std::generic_category(), "INA219 configuration");
+    }
+}
+
+bool Ina219::read(PowerSample &out){
+    uint8_t shunt[2], bus_v[2];
+    if (!bus.read(address, 0x01, shunt, 2) || !bus.read(address, 0x02, bus_v, 2)) return false;
+    double shunt_v = (int16_t)((shunt[0] << 8) | shunt[1]) * 10e-6; // 10 uV per bit at any gain
+    out.voltage = (((bus_v[0] << 8) | bus_v[1]) >> 3) * 4e-3;      // 4 mV per bit
+    out.current = shunt_v / SHUNT_OHMS * 1000.0 * INA_CURRENT_CORRECTION;
+    out.power = out.voltage * out.current;
+    return true;
+}
+
+double dew_point(double temperature, double humidity){
+    const double A = 17.625, B = 243.04;
+    double alpha = A * temperature / (B + temperature) + std::log(humidity / 100.0);
+    return B * alpha / (A - alpha);
+}
+
+bool heater_decide(bool on, const EnvSample &env){
+    double dew = dew_point(env.temperature, env.humidity);
+    if (env.humidity >= 90 || env.temperature <= dew + 2) return true;
+    if (env.humidity < 90 && env.temperature >= dew + 3) return false;
+    return on;
+}
+
+void heater_log(bool on){
+    time_t now = time(nullptr);
+    tm local;
+    localtime_r(&now, &local);
+    char part[64];
+
+    std::string path = HEATER_LOG_DIR;
+    for (const char *fmt : {"/%Y", "/%m", "/%d"}){
+        strftime(part, sizeof(part), fmt, &local);
+        path += part;
+        mkdir(path.c_str(), 0755);
+    }
+    strftime(part, sizeof(part), "/%Y-%m-%d_HeaterLog.csv", &local);
+    path += part;
+
+    bool fresh = access(path.c_str(), F_OK) != 0;
+    FILE *f = fopen(path.c_str(), "a");
+    if (f == nullptr) return;
+    if (fresh) fprintf(f, "Timestamp,Heater state\n");
+    strftime(part, sizeof(part), "%Y-%m-%d %H:%M:%S", &local);
+    fprintf(f, "%s,The heater is %s\n", part, on ? "on" : "off");
+    fclose(f);
+}
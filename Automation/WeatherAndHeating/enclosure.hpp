@@ -0,0 +1,97 @@
+/*
+Enclosure sensors and heater rule from sensing.py and Roko_Petar/ImprovedHeaterControl.py,
+in C++ so they can run as tasks on the station executor instead of separate Python loops.
+BME280(temperature, pressure, humidity) and INA219 power monitors on I2C bus 1.
+*/
+
+#ifndef WEATHER_ENCLOSURE_HPP
+#define WEATHER_ENCLOSURE_HPP
+
+#include <cstdint>
+
+#define I2C_BUS "/dev/i2c-1"
+#define BME_ADDRESS 0x76
+#define INA_CALLISTO_ADDRESS 0x44
+#define INA_HEATER_ADDRESS 0x42
+#define INA_LNA_ADDRESS 0x40
+#define SHUNT_OHMS 0.1
+#define INA_CURRENT_CORRECTION 1.02 // found by comparing the INA219 against a known multimeter
+// INA219 configuration register fields, same values as the Python ina219 library
+#define INA_RANGE_16V 0
+#define INA_RANGE_32V 1
+#define INA_GAIN_AUTO -1 // lowest PGA range that fits max_expected_amps over the shunt
+#define INA_GAIN_1_40MV 0
+#define INA_GAIN_2_80MV 1
+#define INA_GAIN_4_160MV 2
+#define INA_GAIN_8_320MV 3
+#define INA_ADC_12BIT 3
+#define INA_ADC_128SAMP 15
+
+#define HEATER_GPIO 9 // BCM number of physical pin 21, low turns the heater on
+#define HEATER_LOG_DIR "/var/www/callisto/enclosurelogs"
+
+#define BME_MEASURE_MS 10 // forced mode conversion time with 1x oversampling
+
+struct EnvSample {
+    double temperature; // deg C
+    double pressure;    // hPa
+    double humidity;    // %
+};
+
+struct PowerSample {
+    double voltage; // V
+    double current; // mA
+    double power;   // mW
+};
+
+class I2cBus {
+public:
+    explicit I2cBus(const char *path = I2C_BUS);
+    ~I2cBus();
+    I2cBus(const I2cBus &) = delete;
+    I2cBus &operator=(const I2cBus &) = delete;
+
+    bool read(uint8_t address, uint8_t reg, uint8_t *buf, uint16_t len);
+    bool write(uint8_t address, uint8_t reg, uint8_t value);
+    bool write16(uint8_t address, uint8_t reg, uint16_t value); // big endian
+
+private:
+    int fd;
+};
+
+class Bme280 {
+public:
+    Bme280(I2cBus &bus, uint8_t address = BME_ADDRESS);
+    // starts a forced mode conversion, read() it BME_MEASURE_MS later
+    bool start();
+    bool read(EnvSample &out);
+
+private:
+    I2cBus &bus;
+    uint8_t address;
+    uint16_t T1, P1;
+    int16_t T2, T3, P2, P3, P4, P5, P6, P7, P8, P9;
+    uint8_t H1, H3;
+    int16_t H2, H4, H5;
+    int8_t H6;
+};
+
+class Ina219 {
+public:
+    // writes the configuration and calibration registers like ina219.configure() in sensing.py
+    Ina219(I2cBus &bus, uint8_t address, double max_expected_amps, int range,
+        int gain = INA_GAIN_AUTO, int bus_adc = INA_ADC_12BIT, int shunt_adc = INA_ADC_12BIT);
+    bool read(PowerSample &out);
+
+private:
+    I2cBus &bus;
+    uint8_t address;
+};
+
+double dew_point(double temperature, double humidity);
+// hysteresis: on at 90% RH or within 2 deg of the dew point, off below 90% and 3 deg above it
+bool heater_decide(bool on, const EnvSample &env);
+// appends "The heater is on/off" to HEATER_LOG_DIR/YYYY/MM/DD/YYYY-MM-DD_HeaterLog.csv
+void heater_log(bool on);
+
+#endif
@@ -1,6 +1,12 @@
 /*
 Author: Matej Markovic
-compile with: gcc -o cspice_test.exe cspice_test.c -I/path/to/cspice/include -L/path/to/cspice/lib -lm -lcspice -lwiringPi
+compile with: gcc -fopenmp-simd -o tracker.exe main.c Tracking/clock.c Tracking/tracker.c Tracking/ephemeris.c Tracking/latency.c Tracking/solar.c -ITracking -I/path/to/cspice/include -L/path/to/cspice/lib -lm -lcspice -lwiringPi -lpthread
+or without CSPICE: gcc -fopenmp-simd -DEPHEMERIS_ANALYTIC -o tracker.exe main.c Tracking/clock.c Tracking/tracker.c Tracking/ephemeris.c Tracking/latency.c Tracking/solar.c -ITracking -lm -lwiringPi -lpthread
+add -DEPHEMERIS_SERVICE and Tracking/ephem_service.c to ask a running Tracking/ephemd.exe for the hour angle instead,
+  it computes the hour angle itself when ephemd is not running or stops answering
+add -DADAPTIVE_RATE and Tracking/adaptive.c for the event driven control rate(see Tracking/adaptive.h)
+add -DLATENCY_PROBES for the latency histograms(see Tracking/latency.h)
+add -DENCODER_BANK and Tracking/quadrature.c to decode from one read of the GPIO level register(Pi 1-4 only)
 */
 
 #include <stdio.h>
@@ -12,13 +18,22 @@ compile with: gcc -o cspice_test.exe cspice_test.c -I/path/to/cspice/include -L/
 #include <pthread.h>
 #include <wiringPi.h>
 #include <stdbool.h>
-#include "SpiceUsr.h"
-
-// encoder ticks per revolution of output shaft(encoder ticks * gearbox ratio)
-#define TICKS_PER_REV 5000.0f
-#define PID_PERIOD 1.0f // ms
-#define PI 3.14159265358979323846
-#define TARGET_POSITION_UPDATE_MULTIPLIER 5000
+#include <signal.h>
+#include "clock.h"
+#include "tracker.h"
+#include "ephemeris.h"
+#include "latency.h"
+#ifdef EPHEMERIS_SERVICE
+#include "ephem_service.h"
+#endif
+#ifdef ADAPTIVE_RATE
+#include "adaptive.h"
+#endif
+#ifdef ENCODER_BANK
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "quadrature.h"
+#endif
 
 // GPIO pins
 #define STEP_PIN  13
@@ -29,180 +44,147 @@ compile with: gcc -o cspice_test.exe cspice_test.c -I/path/to/cspice/include -L/
 #define LIMIT_SWITCH_PIN 20
 
 // Encoder state
-volatile long encoder_ticks = 0;
-volatile long setpoint = 0;
-
-uint8_t lastState = 0;
+encoder_t encoder;
+#ifdef ENCODER_BANK
+#define GPLEV0 (0x34 / 4) // level register of GPIO 0..31 in /dev/gpiomem
+volatile uint32_t *gpio_bank;
+quad_decoder_t encoders;
+#endif
 
 // Motor command
 volatile float target_step_rate = 0;
 pthread_mutex_t lock;
-
-SpiceDouble getEphemerisTime(){
-    SpiceDouble ephemeris_time; // ephemeris time past J2000
-    time_t rawtime = time(NULL);
-    char utc_str[80];
-
-    struct tm *utc = gmtime(&rawtime);
-    strftime(utc_str, sizeof(utc_str), "%Y-%m-%dT%H:%M:%S", utc);
-    str2et_c(utc_str, &ephemeris_time);
-    printf("time: %d;   ", ephemeris_time);
-
-    return ephemeris_time;
-}
-
-SpiceDouble getHa(){
-    SpiceDouble ephemeris_time = getEphemerisTime();
-    printf("time ha: %d", ephemeris_time);
-
-    SpiceDouble obs_lat = 0.790213649;
-    SpiceDouble obs_lon = 0.239491811;
-    SpiceDouble obs_alt = 0.2235;
-
-    // returns earth radii at different locations to account for ellipsoid shape. Loaded from kernel pck00011.tpc
-    SpiceDouble radii[3];
-    SpiceInt n;
-    bodvrd_c("EARTH", "RADII", 3, &n, radii);
-    SpiceDouble equatorial = radii[0];
-    SpiceDouble polar      = radii[2];
-    SpiceDouble flattening = (equatorial - polar) / equatorial;
-
-    // Observer vector in ITRF93 standard
-    SpiceDouble obs_itrf[3];
-    georec_c(obs_lon, obs_lat, obs_alt, equatorial, flattening, obs_itrf);
-
-    // Sun position wrt Earth in J2000
-    SpiceDouble sun_j2000[3];
-    SpiceDouble lt;
-    spkpos_c("SUN", ephemeris_time, "J2000", "LT+S", "EARTH", sun_j2000, &lt);
-
-    // Observer vector in J2000
-    SpiceDouble xform[3][3]; // transformation matrix
-    SpiceDouble obs_j2000[3];
-    pxform_c("ITRF93", "J2000", ephemeris_time, xform);
-    mxv_c(xform, obs_itrf, obs_j2000);
-
-    // Topocentric Sun vector
-    SpiceDouble sun_obs_j2000[3];
-    vsub_c(sun_j2000, obs_j2000, sun_obs_j2000); // vector subtraction
-
-    // RA
-    SpiceDouble ra  = atan2(sun_obs_j2000[1], sun_obs_j2000[0]);
-    if (ra < 0) ra += 2*PI;
-
-    // Greenwich sidereal RA (RA of ITRF x-axis in J2000)
-    SpiceDouble x_itrf[3] = {1.0, 0.0, 0.0};
-    SpiceDouble x_itrf_j2000[3];
-    mxv_c(xform, x_itrf, x_itrf_j2000); // matrix times vector
-    SpiceDouble ra_greenwich = atan2(x_itrf_j2000[1], x_itrf_j2000[0]);
-    if (ra_greenwich < 0) ra_greenwich += 2*PI;
-
-    // Local Sidereal Time
-    SpiceDouble lst = ra_greenwich + obs_lon;
-    lst = fmod(lst, 2*PI);
-    if (lst < 0) lst += 2*PI;
-
-    // Hour Angle
-    SpiceDouble ha = lst - ra;
-    while (ha <= -PI) ha += 2*PI;
-    while (ha > PI) ha -= 2*PI;
-
-    return ha;
-}
+#ifdef ADAPTIVE_RATE
+pthread_cond_t encoder_event = PTHREAD_COND_INITIALIZER; // wakes the guidance thread
+pthread_cond_t step_wake = PTHREAD_COND_INITIALIZER;     // wakes an idle stepper thread
+#endif
 
 // --- Encoder ISR ---
 void encoderISR(void) {
-    static const int8_t TRANSITION[16] = {
-    0, -1, 1, 0,
-	1, 0, 0, -1,
-	-1, 0, 0, 1,
-	0, 1, -1, 0
-    };
+    LATENCY_SCOPE(LAT_ISR);
+#ifdef ENCODER_BANK
+    // both channels(and any further encoders) in one read instead of a digitalRead per pin
+    uint32_t bank = gpio_bank[GPLEV0];
+    pthread_mutex_lock(&lock);
+    long before = encoders.ticks[0];
+    quad_decode(&encoders, &bank, 1);
+    long delta = encoders.ticks[0] - before;
+    if (delta != 0) encoder.ticks = wrap_ticks(encoder.ticks + delta);
+#else
     int a = digitalRead(ENC_A);
     int b = digitalRead(ENC_B);
 
     uint8_t state = (a << 1) | b;
     pthread_mutex_lock(&lock);
-    uint8_t index = (lastState << 2) | state;
-    int8_t delta = TRANSITION[index];
-    if (delta != 0) encoder_ticks += delta;
-    if (encoder_ticks > TICKS_PER_REV/2) {
-        encoder_ticks -= TICKS_PER_REV;
-    } else if (encoder_ticks < -TICKS_PER_REV/2) {
-        encoder_ticks += TICKS_PER_REV;
-    }
-    lastState = state;
+    int8_t delta = encoder_update(&encoder, state);
+#endif
+#ifdef ADAPTIVE_RATE
+    if (delta != 0) pthread_cond_signal(&encoder_event);
+#else
+    (void)delta;
+#endif
     pthread_mutex_unlock(&lock);
 }
 
 // --- Stepper thread ---
 void *stepperThread(void *arg) {
     printf("Starting stepper thread\n");
+    stepper_t stepper = {0, 0, 0};
     while (1) {
         float step_rate;
         pthread_mutex_lock(&lock);
         step_rate = target_step_rate;
         pthread_mutex_unlock(&lock);
         // printf("%d\n", step_rate);
-        if (fabs(step_rate) < 1.0) {
-            
-            usleep(1000); // idle if rate too low
+        int delay_us = stepper_edge(&stepper, step_rate);
+        if (delay_us == 0) {
+#ifdef ADAPTIVE_RATE
+            // sleep until the guidance thread asks for steps
+            pthread_mutex_lock(&lock);
+            while (step_half_period_us(target_step_rate) == 0) pthread_cond_wait(&step_wake, &lock);
+            pthread_mutex_unlock(&lock);
+#else
+            clock_sleep_us(STEP_IDLE_US); // idle if rate too low
+#endif
             continue;
         }
 
-        int dir = (step_rate >= 0) ? HIGH : LOW;
-        digitalWrite(DIR_PIN, dir);
-
-        float abs_rate = fabs(step_rate);
-        int delay_us = (int)(1000000.0 / (abs_rate * 2.0)); // two edges per step
-        if (delay_us < 50) delay_us = 50; // speed limit
+        digitalWrite(DIR_PIN, stepper.forward ? HIGH : LOW);
 
+        LATENCY_MARK(half_period_start);
         digitalWrite(STEP_PIN, HIGH);
-        usleep(delay_us);
+        clock_sleep_us(delay_us);
+        LATENCY_OVERRUN(LAT_STEP, half_period_start, delay_us * 1000ULL);
+        delay_us = stepper_edge(&stepper, step_rate);
         digitalWrite(STEP_PIN, LOW);
-        usleep(delay_us);
+        clock_sleep_us(delay_us);
     }
     return NULL;
 }
 
 // --- PID loop ---
+guidance_t guidance; // guidance thread only
+
 void pid_update(float dt) {
-    volatile float Kp = 10.0, Ki = 0.0, Kd = 0.0;
+    LATENCY_SCOPE(LAT_PID);
     pthread_mutex_lock(&lock);
-    float loc_setpoint = (float)setpoint; // steps/sec
-    float loc_encoder_ticks = (float)encoder_ticks;
+    long loc_encoder_ticks = encoder.ticks;
+#ifdef ENCODER_BANK
+    unsigned long missed = encoders.missed[0];
+#endif
     pthread_mutex_unlock(&lock);
 
-    float prev_error, integral;
-    float error = loc_setpoint - loc_encoder_ticks;
-    
-
-    integral += error * dt;
-    if (integral > 1000) integral = 1000; // anti-windup
-    if (integral < -1000) integral = -1000;
-
-    float derivative = (error - prev_error) / dt;
-    float output = Kp * error + Ki * integral + Kd * derivative;
-
-    prev_error = error;
+    float output = guidance_control(&guidance, loc_encoder_ticks, dt);
 
     // Update shared step rate
     pthread_mutex_lock(&lock);
     target_step_rate = output; // steps/sec
+#ifdef ADAPTIVE_RATE
+    pthread_cond_signal(&step_wake);
+#endif
     pthread_mutex_unlock(&lock);
-    printf("encoder_ticks: %f;   error: %f;   output/step_rate:%f   ", loc_encoder_ticks, error, output);
+    printf("encoder_ticks: %ld;   error: %f;   output/step_rate:%f   ", loc_encoder_ticks, guidance.error, output);
+#ifdef ENCODER_BANK
+    printf("missed edges: %lu   ", missed);
+#endif
+}
+
+#ifdef EPHEMERIS_SERVICE
+ephem_client_t ephem;
+bool ephem_attached = false, ephemeris_loaded = false;
+
+// guidance thread only: asks ephemd, falls back to our own ephemeris when it does not answer
+SpiceDouble serviceHaAt(double unix_time){
+    if (ephem_attached){
+        double ha = ephem_client_ha(&ephem, EPHEM_SUN, 0, unix_time);
+        if (!isnan(ha)) return ha;
+        printf("ephemd stopped answering, computing the hour angle here\n");
+        ephem_client_detach(&ephem);
+        ephem_attached = false;
+    }
+    if (!ephemeris_loaded){
+        ephemeris_init();
+        ephemeris_loaded = true;
+    }
+    return getHaAt(ephemerisTimeFromUnix(unix_time));
+}
+
+void serviceAttach(void){
+    ephem_attached = ephem_client_attach(&ephem, NULL, EPHEM_SHM_NAME) == 0;
+    if (!ephem_attached) printf("ephemd is not running, computing the hour angle here\n");
 }
+#endif
 
 // --- The antenna knows where it is by knowing where it isnt ---
 void *guidanceThread(void *arg){ 
-    SpiceDouble ha;
-    int loc_setpoint;
+    SpiceDouble ha = 0;
     printf("Guidance thread started\n");
 
-    struct timespec ts;
-    ts.tv_sec = 0;
-    ts.tv_nsec = 1000000 * PID_PERIOD; // period in nanoseconds 
-    volatile uint32_t cycleCounter = TARGET_POSITION_UPDATE_MULTIPLIER + 1;
+    uint64_t period_ns = 1000000 * PID_PERIOD; // period in nanoseconds
+    uint64_t next_wakeup = clock_now_ns();
+#ifdef EPHEMERIS_SERVICE
+    serviceAttach();
+#endif
 
     // ha = getHa();
     // int loc_setpoint = (int)(ha/PI * TICKS_PER_REV + TICKS_PER_REV/4.0f);
@@ -213,42 +195,102 @@ void *guidanceThread(void *arg){
     //     loc_setpoint += TICKS_PER_REV/2;
     // }
     while(1) {
-        if (cycleCounter > TARGET_POSITION_UPDATE_MULTIPLIER){
+        if (guidance_refresh_due(&guidance)){
+#ifdef EPHEMERIS_SERVICE
+            ha = serviceHaAt(clock_now_ns() / (double)NS_PER_SEC);
+#else
             ha = getHa();
-            loc_setpoint = (int)(ha/(2*PI) * TICKS_PER_REV + TICKS_PER_REV/4.0f);
-            if (loc_setpoint > TICKS_PER_REV/2){
-                loc_setpoint -= TICKS_PER_REV/2;
-            } else if (loc_setpoint < -TICKS_PER_REV/2){
-                loc_setpoint += TICKS_PER_REV/2;
-            }
-            cycleCounter = 0;
+#endif
+            guidance.setpoint = ha_to_setpoint(ha);
         }
+
+        printf("ha: %f;   setpoint: %ld;   cycleCounter: %u\n", ha, guidance.setpoint, guidance.cycles);
+        pid_update(PID_PERIOD / 1000.0);
+        next_wakeup += period_ns;
+        clock_sleep_until_ns(next_wakeup);
+    }
+}
+
+#ifdef ADAPTIVE_RATE
+static double haAt(double unix_time, void *ctx){
+    (void)ctx;
+#ifdef EPHEMERIS_SERVICE
+    return serviceHaAt(unix_time);
+#else
+    return getHaAt(ephemerisTimeFromUnix(unix_time));
+#endif
+}
+
+// --- Same job, but only wakes up when the sun crosses a tick or the encoder moves ---
+void *adaptiveGuidanceThread(void *arg){
+    static const char *MODE_NAMES[] = {"tracking", "slewing", "parked"};
+    adaptive_t adaptive;
+    void *ctx = NULL;
+    printf("Adaptive guidance thread started\n");
+#ifdef EPHEMERIS_SERVICE
+    serviceAttach();
+#endif
+    adaptive_init(&adaptive, &SOLAR_SITE, haAt, ctx);
+
+    while(1) {
         pthread_mutex_lock(&lock);
-        setpoint = loc_setpoint;
+        long loc_encoder_ticks = encoder.ticks;
         pthread_mutex_unlock(&lock);
 
-        printf("ha: %f;   setpoint: %d;   cycleCounter: %d\n", ha, loc_setpoint, cycleCounter);
+        double next = adaptive_update(&adaptive, clock_now_ns() / (double)NS_PER_SEC, loc_encoder_ticks);
+        guidance.setpoint = adaptive.setpoint;
         pid_update(PID_PERIOD / 1000.0);
-        nanosleep(&ts, NULL);
-        cycleCounter++;
+        printf("setpoint: %ld;   mode: %s;   next in %.3f s\n", adaptive.setpoint, MODE_NAMES[adaptive.mode],
+            next - clock_now_ns() / (double)NS_PER_SEC);
+
+        // sleep until the deadline or the next encoder edge, unless one came in meanwhile
+        uint64_t deadline = (uint64_t)(next * NS_PER_SEC);
+        pthread_mutex_lock(&lock);
+        while (encoder.ticks == loc_encoder_ticks && clock_cond_wait_until_ns(&encoder_event, &lock, deadline) == 0){
+            continue;
+        }
+        pthread_mutex_unlock(&lock);
     }
 }
+#endif
+
+// --- Limit switch ISR ---
+volatile bool homing_active = false;
+
+// the falling edge marks the home position while homing, the axis stops there and counts from 0
+void limitSwitchISR(void) {
+    pthread_mutex_lock(&lock);
+    if (homing_active) {
+        target_step_rate = 0;
+        encoder.ticks = 0;
+        homing_active = false;
+    }
+    pthread_mutex_unlock(&lock);
+}
 
 void *homing(){
     pthread_mutex_lock(&lock);
+    homing_active = true;
     target_step_rate = -100;
     pthread_mutex_unlock(&lock);
     while(digitalRead(LIMIT_SWITCH_PIN)){
         continue;
     }
-    pthread_mutex_lock(&lock);
-    target_step_rate = 0;
-    encoder_ticks = 0;
-    pthread_mutex_unlock(&lock);
+    limitSwitchISR(); // in case the edge came before the ISR was armed
+    return NULL;
 }
 
 int main(int argc, char **argv){
     printf("Starting Automatic Solar Tracking\n");
+    LATENCY_INIT();
+    // kill -USR1 <pid> appends the latency histograms to this file.
+    // Has to run before wiringPi starts its ISR threads so they inherit the blocked signal.
+    LATENCY_DUMP_ON_SIGNAL(SIGUSR1, "/tmp/tracker_latency.txt");
+    // optional time scale for test runs, e.g. 60 makes an hour of tracking take a minute
+    if (argc > 1 && atof(argv[1]) != 1.0) {
+        clock_init_scaled(atof(argv[1]), 0);
+        printf("Clock scaled %sx\n", argv[1]);
+    }
     wiringPiSetupGpio();
 
     pinMode(STEP_PIN, OUTPUT);
@@ -256,29 +298,45 @@ int main(int argc, char **argv){
     pinMode(EN_PIN, OUTPUT);
     pinMode(ENC_A, INPUT);
     pinMode(ENC_B, INPUT);
+#ifdef ENCODER_BANK
+    int gpiomem = open("/dev/gpiomem", O_RDWR | O_SYNC);
+    if (gpiomem >= 0) gpio_bank = mmap(NULL, 4096, PROT_READ, MAP_SHARED, gpiomem, 0);
+    if (gpiomem < 0 || gpio_bank == MAP_FAILED){
+        perror("/dev/gpiomem");
+        return 1;
+    }
+    quad_init(&encoders, (const uint8_t[]){ENC_A}, (const uint8_t[]){ENC_B}, 1, gpio_bank[GPLEV0]);
+#endif
 
     wiringPiISR(ENC_A, INT_EDGE_BOTH, &encoderISR);
     wiringPiISR(ENC_B, INT_EDGE_BOTH, &encoderISR);
     wiringPiISR(LIMIT_SWITCH_PIN, INT_EDGE_FALLING, &limitSwitchISR);
 
-    furnsh_c("/home/kalisto/cspice/kernels/naif0012.tls");    // leapseconds
-    furnsh_c("/home/kalisto/cspice/kernels/de435.bsp");      // planetary ephemeris
-    furnsh_c("/home/kalisto/cspice/kernels/pck00011.tpc");    // Earth orientation & shape
-    furnsh_c("/home/kalisto/cspice/kernels/earth_000101_260327_251229.bpc"); // earth binary pck
-
+#ifndef EPHEMERIS_SERVICE
+    ephemeris_init();
     printf("Kernels loaded\n");
+#endif
     digitalWrite(EN_PIN, 0);
     printf("Stepper enabled\n");
     pthread_t stepper_thread;
     pthread_t guidance_thread;
     pthread_mutex_init(&lock, NULL);
+    guidance_init(&guidance, 10.0, 0.0, 0.0);
     pthread_create(&stepper_thread, NULL, stepperThread, NULL);
+#ifdef ADAPTIVE_RATE
+    pthread_create(&guidance_thread, NULL, adaptiveGuidanceThread, NULL);
+#else
     pthread_create(&guidance_thread, NULL, guidanceThread, NULL);
+#endif
     
     printf("Threads created\n");
     pthread_join(stepper_thread, NULL);
     pthread_join(guidance_thread, NULL);
-    kclear_c();
+#ifdef EPHEMERIS_SERVICE
+    if (ephemeris_loaded) ephemeris_close();
+#else
+    ephemeris_close();
+#endif
 
     return 0;
 }
@@ -0,0 +1,368 @@
+/*
+Whole station in one process: the step/control loop on its own real-time thread, everything
+else(encoder edges, homing, ephemeris refresh, enclosure sensors, heater, telemetry, signals) as
+coroutines on one epoll executor(see Tracking/executor.hpp). Replaces the WeatherAndHeating Python
+loops. GPIO goes through /dev/gpiochip0, no wiringPi; main.c stays the wiringPi build of the
+tracker alone. Both run the loop bodies of Tracking/tracker.c.
+The control thread only runs while the axis has to move. Once the error is zero it sleeps
+until the executor wakes it for an encoder edge, a new setpoint, homing or shutdown.
+compile with: gcc -O2 -fopenmp-simd -c Tracking/clock.c Tracking/tracker.c Tracking/ephemeris.c Tracking/solar.c Tracking/latency.c -I/path/to/cspice/include
+              g++ -std=c++20 -O2 -o station.exe station.cpp Tracking/executor.cpp Tracking/gpio_line.cpp WeatherAndHeating/enclosure.cpp clock.o tracker.o ephemeris.o solar.o latency.o -ITracking -IWeatherAndHeating -I/path/to/cspice/include -L/path/to/cspice/lib -lcspice -lm -lpthread
+or without CSPICE: add -DEPHEMERIS_ANALYTIC to both and drop the cspice paths
+usage: ./station.exe [--home]
+*/
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include "clock.h"
+#include "tracker.h"
+#include "ephemeris.h"
+#include "latency.h"
+#include "executor.hpp"
+#include "gpio_line.hpp"
+#include "enclosure.hpp"
+
+// GPIO pins, same as main.c
+constexpr unsigned STEP_PIN = 13;
+constexpr unsigned DIR_PIN = 5;
+constexpr unsigned EN_PIN = 6;
+constexpr unsigned ENC_A = 27;
+constexpr unsigned ENC_B = 17;
+constexpr unsigned LIMIT_SWITCH_PIN = 20;
+
+constexpr uint64_t MS = 1000000ULL;
+constexpr uint64_t PID_PERIOD_NS = (uint64_t)(PID_PERIOD * MS);
+constexpr uint64_t EPHEMERIS_PERIOD_NS = PID_PERIOD_NS * TARGET_POSITION_UPDATE_MULTIPLIER;
+constexpr uint64_t SENSOR_PERIOD_NS = 1000 * MS;    // sensing.py
+constexpr uint64_t HEATER_PERIOD_NS = 60000 * MS;   // ImprovedHeaterControl.py ran from cron every minute
+constexpr uint64_t TELEMETRY_PERIOD_NS = 10000 * MS;
+constexpr float HOMING_RATE = -100; // steps/sec towards the limit switch
+constexpr int CONTROL_PRIORITY = 80; // SCHED_FIFO
+const char *TELEMETRY_PATH = "/tmp/station_telemetry.csv";
+
+// written by the executor, read by the control thread
+std::atomic<long> encoder_ticks{0};
+std::atomic<long> setpoint{0};
+std::atomic<float> manual_rate{NAN}; // fixed step rate instead of the PID while homing
+std::atomic<bool> running{true};
+int control_wake = -1; // eventfd, written after changing any of the above
+
+// executor thread only
+encoder_t encoder;
+EnvSample env{NAN, NAN, NAN};
+PowerSample power[3]{};
+bool heater_on = false;
+std::vector<std::string> telemetry;
+
+static uint64_t mono_ns(){
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline_ns){
+    timespec ts;
+    ts.tv_sec = deadline_ns / 1000000000ULL;
+    ts.tv_nsec = deadline_ns % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR){
+        continue;
+    }
+}
+
+// --- Control thread: PID and step pulses, nothing else ---
+static void wake_control(){
+    uint64_t one = 1;
+    ssize_t ignored = write(control_wake, &one, sizeof(one));
+    (void)ignored;
+}
+
+// blocks until wake_control() unless the inputs already changed from what the loop last saw
+static void wait_for_change(long ticks, long target){
+    uint64_t count;
+    while (read(control_wake, &count, sizeof(count)) > 0) continue;
+    if (!running || encoder_ticks.load() != ticks || setpoint.load() != target || !std::isnan(manual_rate.load())) return;
+    pollfd pfd = {control_wake, POLLIN, 0};
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR) continue;
+}
+
+void *controlThread(void *arg){
+    GpioLines &motor = *static_cast<GpioLines *>(arg);
+    guidance_t guidance;
+    guidance_init(&guidance, 10.0, 0.0, 0.0);
+    stepper_t stepper = {0, 0, 0};
+    float step_rate = 0;
+    uint64_t next_pid = mono_ns();
+    uint64_t next_edge = UINT64_MAX;
+
+    while (running.load(std::memory_order_relaxed)){
+        uint64_t now = mono_ns();
+        bool settled = false;
+        long ticks = 0;
+        if (now >= next_pid){
+            LATENCY_SCOPE(LAT_PID);
+            ticks = encoder_ticks.load(std::memory_order_relaxed);
+            float manual = manual_rate.load(std::memory_order_relaxed);
+            float prev_error = guidance.error;
+            guidance.setpoint = setpoint.load(std::memory_order_relaxed);
+            step_rate = guidance_control(&guidance, ticks, PID_PERIOD / 1000.0);
+            if (!std::isnan(manual)) step_rate = manual;
+            next_pid += PID_PERIOD_NS;
+            if (next_edge == UINT64_MAX && step_half_period_us(step_rate) != 0) next_edge = now;
+            // on target and the PID output can not change by itself anymore
+            settled = next_edge == UINT64_MAX && std::isnan(manual) && guidance.error == 0 && prev_error == 0;
+        }
+        if (settled){
+            wait_for_change(ticks, guidance.setpoint);
+            next_pid = mono_ns();
+            continue;
+        }
+        if (now >= next_edge){
+            int delay_us = stepper_edge(&stepper, step_rate);
+            if (delay_us == 0){
+                next_edge = UINT64_MAX; // idle until the PID asks for steps
+            } else {
+                if (stepper.high) motor.set(1, stepper.forward);
+                motor.set(0, stepper.high);
+                next_edge = now + (uint64_t)delay_us * 1000ULL;
+            }
+        }
+        sleep_until(next_edge < next_pid ? next_edge : next_pid);
+    }
+    motor.set(0, 0);
+    return nullptr;
+}
+
+// --- Executor tasks ---
+// the kernel queues and timestamps the edges, this decodes them as soon as they come
+Task encoderEvents(Executor &ex, GpioLines &lines){
+    uint32_t next_seqno = 0;
+    int a = lines.get(0), b = lines.get(1);
+    encoder_init(&encoder, (uint8_t)((a << 1) | b));
+    gpio_v2_line_event ev;
+    while (running){
+        co_await ex.readable(lines.fd());
+        long before = encoder.ticks;
+        while (lines.read_event(ev)){
+            // seqno counts over both lines, a jump means the kernel queue overflowed
+            int32_t lost = (int32_t)(ev.seqno - next_seqno);
+            if (next_seqno && lost > 0) encoder.missed_edges += lost;
+            next_seqno = ev.seqno + 1;
+            int level = ev.id == GPIO_V2_LINE_EVENT_RISING_EDGE;
+            if (ev.offset == ENC_A) a = level;
+            else b = level;
+            encoder_update(&encoder, (uint8_t)((a << 1) | b));
+        }
+        if (encoder.ticks != before){
+            encoder_ticks.store(encoder.ticks);
+            wake_control();
+        }
+    }
+}
+
+Task ephemerisRefresh(Executor &ex){
+    Timer timer(ex, EPHEMERIS_PERIOD_NS);
+    while (running){
+        long target = ha_to_setpoint(getHa());
+        if (setpoint.exchange(target) != target) wake_control();
+        co_await timer;
+    }
+}
+
+// drive towards the limit switch until its falling edge, then start tracking from there
+Task homing(Executor &ex, GpioLines &limit){
+    printf("Homing\n");
+    manual_rate = HOMING_RATE;
+    wake_control();
+    gpio_v2_line_event ev;
+    while (running && limit.get(0) != 0){
+        co_await ex.readable(limit.fd());
+        while (limit.read_event(ev)) continue;
+    }
+    encoder.ticks = 0;
+    encoder_ticks.store(0);
+    manual_rate = NAN;
+    wake_control();
+    printf("Homed\n");
+    ephemerisRefresh(ex);
+}
+
+Task sensorPolling(Executor &ex, Bme280 &bme, std::vector<Ina219> &ina){
+    Timer period(ex, SENSOR_PERIOD_NS);
+    Timer conversion(ex);
+    while (running){
+        if (bme.start()){
+            co_await conversion.after(BME_MEASURE_MS * MS);
+            bme.read(env);
+        }
+        for (int i = 0; i < 3; i++) ina[i].read(power[i]);
+
+        char line[256];
+        snprintf(line, sizeof(line), "%ld,%ld,%ld,%.2f,%.2f,%.1f,%.3f,%.1f,%.3f,%.1f,%.3f,%.1f,%d\n",
+            (long)clock_time(), setpoint.load(), encoder_ticks.load(), env.temperature, env.pressure, env.humidity,
+            power[0].voltage, power[0].current, power[1].voltage, power[1].current, power[2].voltage, power[2].current,
+            heater_on);
+        telemetry.push_back(line);
+        co_await period;
+    }
+}
+
+Task heaterControl(Executor &ex, GpioLines &heater){
+    Timer timer(ex, HEATER_PERIOD_NS);
+    bool first = true;
+    while (running){
+        if (!std::isnan(env.humidity)){
+            bool on = heater_decide(heater_on, env);
+            if (on != heater_on || first){
+                heater.set(0, on ? 0 : 1); // active low
+                heater_log(on);
+                heater_on = on;
+                first = false;
+            }
+        }
+        co_await timer;
+    }
+}
+
+// one open/write/close for everything collected since the last flush
+static void flushTelemetry(){
+    if (telemetry.empty()) return;
+    bool fresh = access(TELEMETRY_PATH, F_OK) != 0;
+    FILE *f = fopen(TELEMETRY_PATH, "a");
+    if (f == nullptr) return;
+    if (fresh) fputs("time,setpoint,encoder,temperature,pressure,humidity,callisto_V,callisto_mA,heater_V,heater_mA,lna_V,lna_mA,heater_on\n", f);
+    for (const std::string &line : telemetry) fputs(line.c_str(), f);
+    fclose(f);
+    telemetry.clear();
+}
+
+Task telemetryFlush(Executor &ex){
+    Timer timer(ex, TELEMETRY_PERIOD_NS);
+    while (running){
+        co_await timer;
+        flushTelemetry();
+    }
+}
+
+Task signals(Executor &ex, int fd){
+    while (running){
+        co_await ex.readable(fd);
+        signalfd_siginfo info;
+        if (read(fd, &info, sizeof(info)) != sizeof(info)) continue;
+        if (info.ssi_signo == SIGUSR1){
+            LATENCY_DUMP_FILE("/tmp/tracker_latency.txt");
+            continue;
+        }
+        running = false;
+        wake_control();
+        ex.stop();
+    }
+}
+
+int main(int argc, char **argv){
+    bool home = argc > 1 && strcmp(argv[1], "--home") == 0;
+    printf("Starting station\n");
+    LATENCY_INIT();
+
+    // blocked in every thread, the executor reads them from a signalfd
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    int signal_fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+
+    ephemeris_init();
+    printf("Kernels loaded\n");
+
+    Executor ex;
+    std::unique_ptr<GpioLines> encoder_lines, motor, limit;
+    try {
+        encoder_lines = std::make_unique<GpioLines>(std::initializer_list<unsigned>{ENC_A, ENC_B}, GpioLines::BOTH_EDGES, "encoder");
+        motor = std::make_unique<GpioLines>(std::initializer_list<unsigned>{STEP_PIN, DIR_PIN, EN_PIN}, GpioLines::OUTPUT, "stepper");
+        limit = std::make_unique<GpioLines>(std::initializer_list<unsigned>{LIMIT_SWITCH_PIN}, GpioLines::FALLING_EDGE, "limit");
+    } catch (const std::exception &e){
+        std::cerr << "GPIO: " << e.what() << "\n";
+        return 1;
+    }
+    motor->set(2, 0);
+    printf("Stepper enabled\n");
+
+    // enclosure is optional, the tracker runs without it
+    std::unique_ptr<I2cBus> bus;
+    std::unique_ptr<Bme280> bme;
+    std::unique_ptr<GpioLines> heater;
+    std::vector<Ina219> ina;
+    try {
+        bus = std::make_unique<I2cBus>();
+        bme = std::make_unique<Bme280>(*bus);
+        // Callisto, heater and LNA as configured in sensing.py
+        ina.reserve(3);
+        ina.emplace_back(*bus, INA_CALLISTO_ADDRESS, 0.3, INA_RANGE_16V);
+        ina.emplace_back(*bus, INA_HEATER_ADDRESS, 3.0, INA_RANGE_32V);
+        ina.emplace_back(*bus, INA_LNA_ADDRESS, 0.05, INA_RANGE_16V, INA_GAIN_1_40MV, INA_ADC_128SAMP);
+        heater = std::make_unique<GpioLines>(std::initializer_list<unsigned>{HEATER_GPIO}, GpioLines::OUTPUT, "heater", 1);
+    } catch (const std::exception &e){
+        std::cerr << "enclosure disabled: " << e.what() << "\n";
+        bme.reset();
+    }
+
+    control_wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    encoderEvents(ex, *encoder_lines);
+
+    pthread_t control_thread;
+    pthread_attr_t attr;
+    sched_param param{};
+    param.sched_priority = CONTROL_PRIORITY;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+    if (pthread_create(&control_thread, &attr, controlThread, motor.get()) != 0){
+        printf("no SCHED_FIFO(not root?), control thread runs at normal priority\n");
+        pthread_create(&control_thread, nullptr, controlThread, motor.get());
+    }
+
+    signals(ex, signal_fd);
+    if (home) homing(ex, *limit);
+    else ephemerisRefresh(ex);
+    if (bme){
+        sensorPolling(ex, *bme, ina);
+        heaterControl(ex, *heater);
+    }
+    telemetryFlush(ex);
+    printf("Tasks started\n");
+
+    ex.run();
+    // the lines and signalfd close below, before the executor
+    ex.unwatch(encoder_lines->fd());
+    ex.unwatch(limit->fd());
+    ex.unwatch(signal_fd);
+    close(signal_fd);
+
+    pthread_join(control_thread, nullptr);
+    flushTelemetry();
+    motor->set(2, 1);
+    ephemeris_close();
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("executor wakeups: %llu;   context switches: %ld voluntary, %ld involuntary;   missed edges: %ld\n",
+        (unsigned long long)ex.wakeups(), usage.ru_nvcsw, usage.ru_nivcsw, encoder.missed_edges);
+    return 0;
+}
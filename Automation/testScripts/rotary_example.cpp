@@ -2,6 +2,7 @@
 #include <iostream>
 #include <atomic>
 #include <csignal>
+#include "../Tracking/latency.h"
 
 constexpr unsigned int PIN_A = 17;
 constexpr unsigned int PIN_B = 27;
@@ -16,6 +17,9 @@ uint8_t lastState = 0;
 // Interrupt callback for channel A
 void cbfA(int gpio, int level, uint32_t tick) {
     if (level == PI_TIMEOUT) return; // ignore timeouts
+    // tick is when pigpio sampled the edge, in us
+    LATENCY_RECORD_NS(LAT_ISR_EDGE, (uint64_t)(gpioTick() - tick) * 1000ULL);
+    LATENCY_SCOPE(LAT_ISR);
 
     int a = gpioRead(PIN_A);
     int b = gpioRead(PIN_B);
@@ -50,6 +54,8 @@ int main() {
         return 1;
     }
 
+    LATENCY_INIT();
+
     // SIGINT is user interrupt
     signal(SIGINT, sigintHandler);
 
@@ -82,5 +88,6 @@ int main() {
     }
 
     gpioTerminate();
+    LATENCY_DUMP_FILE("/tmp/rotary_latency.txt");
     return 0;
 }